@@ -0,0 +1,468 @@
+#include "include/Cache.h"
+#include "llvm/IR/InlineAsm.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/Support/DataExtractor.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+
+using namespace llvm;
+
+// Changes of the hash or of the layout of the files must bump the version
+static const char CacheMagic[4] = {'I', 'R', 'P', 'C'};
+static const uint32_t CacheVersion = 2;
+
+namespace {
+/* FunctionHasher
+ * Structural hash of a function, local values are hashed by their position
+ * so that the hash does not depend on the addresses or the value names
+ */
+class FunctionHasher {
+	MD5 Hash;
+	DenseMap<const Value*, uint64_t> Locals;
+	SmallPtrSet<StructType*, 16> Structs;
+	void addInt(uint64_t V) {
+		uint8_t Bytes[8];
+		support::endian::write64le(Bytes, V);
+		Hash.update(Bytes);
+	}
+	void addString(StringRef S) {
+		addInt(S.size());
+		Hash.update(S);
+	}
+	// hash_value of an APInt is not stable across executions, the words
+	// are hashed instead
+	void addAPInt(const APInt& A) {
+		addInt(A.getBitWidth());
+		for (unsigned I = 0; I < A.getNumWords(); I++) {
+			addInt(A.getRawData()[I]);
+		}
+	}
+	void addType(Type*);
+	void addValue(const Value*);
+
+       public:
+	MD5::MD5Result hash(Function&);
+};
+}  // namespace
+
+void FunctionHasher::addType(Type* T) {
+	addInt(T->getTypeID());
+	if (IntegerType* IT = dyn_cast<IntegerType>(T)) {
+		addInt(IT->getBitWidth());
+	} else if (PointerType* PT = dyn_cast<PointerType>(T)) {
+		addInt(PT->getAddressSpace());
+		if (!PT->isOpaque()) {
+			addType(PT->getPointerElementType());
+		}
+	} else if (StructType* ST = dyn_cast<StructType>(T)) {
+		// The body of a named struct is hashed once, recursive types
+		// refer to it by name
+		if (ST->hasName()) {
+			addString(ST->getName());
+			if (!Structs.insert(ST).second) {
+				return;
+			}
+		}
+		addInt(ST->isPacked());
+		addInt(ST->isOpaque() ? ~0ull : ST->getNumElements());
+		for (Type* E : ST->elements()) {
+			addType(E);
+		}
+	} else if (ArrayType* AT = dyn_cast<ArrayType>(T)) {
+		addInt(AT->getNumElements());
+		addType(AT->getElementType());
+	} else if (FixedVectorType* VT = dyn_cast<FixedVectorType>(T)) {
+		addInt(VT->getNumElements());
+		addType(VT->getElementType());
+	} else if (FunctionType* FT = dyn_cast<FunctionType>(T)) {
+		addInt(FT->isVarArg());
+		addInt(FT->getNumParams());
+		for (Type* P : FT->subtypes()) {
+			addType(P);
+		}
+	}
+}
+
+void FunctionHasher::addValue(const Value* V) {
+	auto It = Locals.find(V);
+	if (It != Locals.end()) {
+		addInt('L');
+		addInt(It->second);
+		return;
+	}
+	addInt(V->getValueID());
+	addType(V->getType());
+	if (const GlobalValue* GV = dyn_cast<GlobalValue>(V)) {
+		addString(GV->getName());
+	} else if (const ConstantInt* CI = dyn_cast<ConstantInt>(V)) {
+		addAPInt(CI->getValue());
+	} else if (const ConstantFP* CF = dyn_cast<ConstantFP>(V)) {
+		addAPInt(CF->getValueAPF().bitcastToAPInt());
+	} else if (const ConstantDataSequential* CD =
+		       dyn_cast<ConstantDataSequential>(V)) {
+		addString(CD->getRawDataValues());
+	} else if (const ConstantExpr* CE = dyn_cast<ConstantExpr>(V)) {
+		addInt(CE->getOpcode());
+		if (CE->isCompare()) {
+			addInt(CE->getPredicate());
+		}
+		if (const GEPOperator* GEP = dyn_cast<GEPOperator>(CE)) {
+			addType(GEP->getSourceElementType());
+		}
+		for (const Value* Op : CE->operands()) {
+			addValue(Op);
+		}
+	} else if (const Constant* C = dyn_cast<Constant>(V)) {
+		// aggregates and block addresses
+		for (const Value* Op : C->operands()) {
+			addValue(Op);
+		}
+	} else if (const InlineAsm* IA = dyn_cast<InlineAsm>(V)) {
+		addString(IA->getAsmString());
+		addString(IA->getConstraintString());
+	}
+}
+
+MD5::MD5Result FunctionHasher::hash(Function& F) {
+	for (Argument& A : F.args()) {
+		uint64_t Id = Locals.size();
+		Locals[&A] = Id;
+	}
+	for (BasicBlock& BB : F) {
+		uint64_t Id = Locals.size();
+		Locals[&BB] = Id;
+		for (Instruction& I : BB) {
+			uint64_t InstId = Locals.size();
+			Locals[&I] = InstId;
+		}
+	}
+	addInt(CacheVersion);
+	addType(F.getFunctionType());
+	for (BasicBlock& BB : F) {
+		addInt(BB.size());
+		for (Instruction& I : BB) {
+			addInt(I.getOpcode());
+			addType(I.getType());
+			addInt(I.getNumOperands());
+			for (Value* Op : I.operands()) {
+				addValue(Op);
+			}
+			if (AllocaInst* AI = dyn_cast<AllocaInst>(&I)) {
+				addType(AI->getAllocatedType());
+			} else if (GetElementPtrInst* GEP =
+				       dyn_cast<GetElementPtrInst>(&I)) {
+				addType(GEP->getSourceElementType());
+			} else if (CmpInst* Cmp = dyn_cast<CmpInst>(&I)) {
+				addInt(Cmp->getPredicate());
+			} else if (CallBase* CB = dyn_cast<CallBase>(&I)) {
+				addType(CB->getFunctionType());
+			} else if (PHINode* Phi = dyn_cast<PHINode>(&I)) {
+				for (BasicBlock* In : Phi->blocks()) {
+					addValue(In);
+				}
+			}
+		}
+	}
+	MD5::MD5Result Result;
+	Hash.final(Result);
+	return Result;
+}
+
+namespace {
+enum ValueTag : uint8_t {
+	NullValue,
+	InstValue,
+	ArgValue,
+	GlobalValueTag,
+	// A constant, by the instruction and operand it was first used at
+	OperandValue
+};
+
+/* ValueEncoder
+ * Writes the values of the metadata of a function as references into it
+ */
+class ValueEncoder {
+	raw_ostream& OS;
+	support::endian::Writer W;
+	DenseMap<const Value*, uint32_t> Insts;
+	DenseMap<const Value*, std::pair<uint32_t, uint32_t>> Operands;
+	// Some value of the function of every type, the type of an expression
+	// is written as one of them
+	DenseMap<Type*, const Value*> TypeValues;
+
+       public:
+	bool Valid = true;
+	ValueEncoder(raw_ostream& OS, Function& F)
+	    : OS(OS), W(OS, support::little) {
+		for (Argument& A : F.args()) {
+			TypeValues.insert({A.getType(), &A});
+		}
+		for (Instruction& I : instructions(F)) {
+			uint32_t Id = Insts.size();
+			Insts[&I] = Id;
+			TypeValues.insert({I.getType(), &I});
+			for (Use& U : I.operands()) {
+				if (isa<Constant>(U) && !isa<GlobalValue>(U)) {
+					Operands.insert({U, {Id, U.getOperandNo()}});
+				}
+			}
+		}
+	}
+	void write(uint32_t V) { W.write<uint32_t>(V); }
+	void writeValue(const Value* V) {
+		if (!V) {
+			W.write<uint8_t>(NullValue);
+			return;
+		}
+		auto It = Insts.find(V);
+		if (It != Insts.end()) {
+			W.write<uint8_t>(InstValue);
+			write(It->second);
+		} else if (Operands.count(V)) {
+			W.write<uint8_t>(OperandValue);
+			write(Operands[V].first);
+			write(Operands[V].second);
+		} else if (const Argument* A = dyn_cast<Argument>(V)) {
+			W.write<uint8_t>(ArgValue);
+			write(A->getArgNo());
+		} else if (isa<GlobalValue>(V) && V->hasName()) {
+			W.write<uint8_t>(GlobalValueTag);
+			write(V->getName().size());
+			OS << V->getName();
+		} else {
+			W.write<uint8_t>(NullValue);
+			Valid = false;
+		}
+	}
+	void writeType(Type* T, const Expression& Exp) {
+		if (!T) {
+			writeValue(nullptr);
+			return;
+		}
+		for (Value* V : {(Value*)Exp.base, Exp.optional, Exp.functionArg}) {
+			if (V && V->getType() == T) {
+				writeValue(V);
+				return;
+			}
+		}
+		const Value* V = TypeValues.lookup(T);
+		Valid &= V != nullptr;
+		writeValue(V);
+	}
+	void writeExpression(const Expression& Exp) {
+		writeValue(Exp.base);
+		writeValue(Exp.optional);
+		writeType(Exp.type, Exp);
+		W.write<uint8_t>(Exp.symbol);
+		writeValue(Exp.functionArg);
+		W.write<uint8_t>(Exp.RHSisAddress);
+	}
+};
+
+void writeArray(support::endian::Writer& W,
+		const std::vector<uint32_t>& Values) {
+	W.write<uint32_t>(Values.size());
+	for (uint32_t V : Values) {
+		W.write<uint32_t>(V);
+	}
+}
+
+/* ValueDecoder
+ * Reads what ValueEncoder wrote, every error leaves the cursor failed
+ */
+class ValueDecoder {
+	DataExtractor Data;
+	Module& M;
+	std::vector<Instruction*> Insts;
+	Function& F;
+
+       public:
+	DataExtractor::Cursor C;
+	bool Valid = true;
+	ValueDecoder(StringRef Buffer, Function& F)
+	    : Data(Buffer, true, 8), M(*F.getParent()), F(F), C(0) {
+		for (Instruction& I : instructions(F)) {
+			Insts.push_back(&I);
+		}
+	}
+	uint32_t read() { return Data.getU32(C); }
+	Value* readValue() {
+		uint8_t Tag = Data.getU8(C);
+		if (Tag == NullValue) {
+			return nullptr;
+		}
+		uint32_t V = read();
+		if (Tag == InstValue && V < Insts.size()) {
+			return Insts[V];
+		}
+		if (Tag == ArgValue && V < F.arg_size()) {
+			return F.getArg(V);
+		}
+		if (Tag == OperandValue) {
+			uint32_t OpNo = read();
+			if (V < Insts.size() && OpNo < Insts[V]->getNumOperands()) {
+				return Insts[V]->getOperand(OpNo);
+			}
+		}
+		if (Tag == GlobalValueTag) {
+			StringRef Name = Data.getBytes(C, V);
+			if (GlobalValue* GV = M.getNamedValue(Name)) {
+				return GV;
+			}
+		}
+		Valid = false;
+		return nullptr;
+	}
+	template <typename T>
+	T* readValueAs() {
+		Value* V = readValue();
+		if (V && !isa<T>(V)) {
+			Valid = false;
+			return nullptr;
+		}
+		return cast_or_null<T>(V);
+	}
+	void readExpression(Expression& Exp) {
+		Exp.base = readValueAs<Instruction>();
+		Exp.optional = readValue();
+		Value* TypeValue = readValue();
+		Exp.type = TypeValue ? TypeValue->getType() : nullptr;
+		uint8_t Symbol = Data.getU8(C);
+		Valid &= Symbol <= newObj;
+		Exp.symbol = (SymbolType)Symbol;
+		Exp.functionArg = readValue();
+		Exp.RHSisAddress = Data.getU8(C);
+	}
+	void readArray(std::vector<uint32_t>& Values) {
+		uint32_t Size = read();
+		// Every element takes four bytes
+		if (!Data.isValidOffsetForDataOfSize(C.tell(), uint64_t(Size) * 4)) {
+			Valid = false;
+			return;
+		}
+		Values.resize(Size);
+		for (uint32_t& V : Values) {
+			V = read();
+		}
+	}
+};
+}  // namespace
+
+SummaryCache::SummaryCache(StringRef Dir) : Dir(Dir.str()) {
+	sys::fs::create_directories(Dir);
+}
+
+std::string SummaryCache::getPath(const MD5::MD5Result& Key) const {
+	SmallString<128> Path(Dir);
+	SmallString<32> Name = Key.digest();
+	Name += ".irpp";
+	sys::path::append(Path, Name);
+	return std::string(Path.str());
+}
+
+std::unique_ptr<FunctionSummary> SummaryCache::lookup(Function& F) {
+	std::unique_ptr<FunctionSummary> Summary(new FunctionSummary());
+	Summary->Key = FunctionHasher().hash(F);
+	auto Buffer = MemoryBuffer::getFile(getPath(Summary->Key));
+	if (!Buffer) {
+		return Summary;
+	}
+	StringRef Contents = (*Buffer)->getBuffer();
+	if (!Contents.startswith(StringRef(CacheMagic, 4))) {
+		return Summary;
+	}
+	ValueDecoder D(Contents, F);
+	D.C.seek(4);
+	bool Valid = D.read() == CacheVersion;
+	FunctionMetaData& FMD = Summary->MetaData;
+	for (uint32_t N = Valid ? D.read() : 0; N && D.C && D.Valid; N--) {
+		StoreInst* SI = D.readValueAs<StoreInst>();
+		// RawUpdateInst generates its expressions, they are overwritten
+		FMD.Updates.emplace_back();
+		RawUpdateInst& U = FMD.Updates.back();
+		U.Inst = SI;
+		D.readExpression(U.LHS);
+		D.readExpression(U.RHS);
+		Valid &= SI != nullptr;
+	}
+	for (uint32_t N = Valid ? D.read() : 0; N && D.C && D.Valid; N--) {
+		CallInst* CI = D.readValueAs<CallInst>();
+		Expression Receiver;
+		D.readExpression(Receiver);
+		FMD.Receivers.emplace_back(CI, Receiver);
+		Valid &= CI != nullptr;
+	}
+	CFGShape& Shape = Summary->Shape;
+	D.readArray(Shape.SuccOffsets);
+	D.readArray(Shape.Succs);
+	D.readArray(Shape.AbsNodes);
+	D.readArray(Shape.AbsSuccOffsets);
+	D.readArray(Shape.AbsSuccs);
+	Valid &= D.Valid && (bool)D.C;
+	consumeError(D.C.takeError());
+	if (!Valid) {
+		Summary->MetaData = FunctionMetaData();
+		Summary->Shape = CFGShape();
+		return Summary;
+	}
+	Summary->Found = true;
+	return Summary;
+}
+
+bool SummaryCache::encode(Function& F, const FunctionMetaData& FMD,
+			  FunctionSummary& Summary) {
+	raw_string_ostream OS(Summary.Buffer);
+	ValueEncoder E(OS, F);
+	OS.write(CacheMagic, 4);
+	E.write(CacheVersion);
+	E.write(FMD.Updates.size());
+	for (const RawUpdateInst& U : FMD.Updates) {
+		E.writeValue(U.Inst);
+		E.writeExpression(U.LHS);
+		E.writeExpression(U.RHS);
+	}
+	E.write(FMD.Receivers.size());
+	for (auto& Receiver : FMD.Receivers) {
+		E.writeValue(Receiver.first);
+		E.writeExpression(Receiver.second);
+	}
+	OS.flush();
+	return E.Valid;
+}
+
+/* store
+ * The file is written under a unique name and renamed so that concurrent
+ * runs never read a partial file
+ */
+void SummaryCache::store(FunctionSummary& Summary, const CFG& G) {
+	CFGShape Shape = G.getShape();
+	{
+		raw_string_ostream OS(Summary.Buffer);
+		support::endian::Writer W(OS, support::little);
+		writeArray(W, Shape.SuccOffsets);
+		writeArray(W, Shape.Succs);
+		writeArray(W, Shape.AbsNodes);
+		writeArray(W, Shape.AbsSuccOffsets);
+		writeArray(W, Shape.AbsSuccs);
+	}
+	std::string Path = getPath(Summary.Key);
+	SmallString<128> TempPath;
+	int FD;
+	if (sys::fs::createUniqueFile(Path + ".tmp%%%%%%", FD, TempPath)) {
+		return;
+	}
+	{
+		raw_fd_ostream OS(FD, true);
+		OS << Summary.Buffer;
+		if (OS.has_error()) {
+			OS.clear_error();
+			sys::fs::remove(TempPath);
+			return;
+		}
+	}
+	if (sys::fs::rename(TempPath, Path)) {
+		sys::fs::remove(TempPath);
+	}
+}
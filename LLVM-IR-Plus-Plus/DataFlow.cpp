@@ -0,0 +1,414 @@
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <vector>
+#include "include/DataFlow.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/TimeProfiler.h"
+
+using namespace llvm;
+
+unsigned BitSetRef::count() const {
+	unsigned Count = 0;
+	for (unsigned W = 0; W < NumWords; W++) {
+		Count += countPopulation(Words[W]);
+	}
+	return Count;
+}
+
+/* The kernels fold the difference of every word into one accumulator instead
+ * of exiting early, so that the loops have no branches and are vectorized.
+ * Operands never alias, which is told to the compiler by __restrict.
+ */
+bool bitset::unionWith(uint64_t* __restrict Dst,
+		       const uint64_t* __restrict Src, unsigned N) {
+	uint64_t Diff = 0;
+	for (unsigned I = 0; I < N; I++) {
+		uint64_t New = Dst[I] | Src[I];
+		Diff |= New ^ Dst[I];
+		Dst[I] = New;
+	}
+	return Diff != 0;
+}
+
+bool bitset::intersectWith(uint64_t* __restrict Dst,
+			   const uint64_t* __restrict Src, unsigned N) {
+	uint64_t Diff = 0;
+	for (unsigned I = 0; I < N; I++) {
+		uint64_t New = Dst[I] & Src[I];
+		Diff |= New ^ Dst[I];
+		Dst[I] = New;
+	}
+	return Diff != 0;
+}
+
+void bitset::subtract(uint64_t* __restrict Dst, const uint64_t* __restrict Src,
+		      unsigned N) {
+	for (unsigned I = 0; I < N; I++) {
+		Dst[I] &= ~Src[I];
+	}
+}
+
+bool bitset::equals(const uint64_t* __restrict A, const uint64_t* __restrict B,
+		    unsigned N) {
+	uint64_t Diff = 0;
+	for (unsigned I = 0; I < N; I++) {
+		Diff |= A[I] ^ B[I];
+	}
+	return Diff == 0;
+}
+
+bool bitset::transfer(uint64_t* __restrict Dst, const uint64_t* __restrict Src,
+		      const uint64_t* __restrict Gen,
+		      const uint64_t* __restrict Kill, unsigned N) {
+	uint64_t Diff = 0;
+	for (unsigned I = 0; I < N; I++) {
+		uint64_t New = Gen[I] | (Src[I] & ~Kill[I]);
+		Diff |= New ^ Dst[I];
+		Dst[I] = New;
+	}
+	return Diff != 0;
+}
+
+/* Constructor for DataFlowSolver
+ * Allocates the sets of every node of the abstracted cfg and asks the problem
+ * for the gen and kill sets
+ */
+DataFlowSolver::DataFlowSolver(CFG& G, DataFlowProblem& Problem)
+    : G(G), Problem(Problem) {
+	NumNodes = G.getAbstractedNodes().size();
+	WordsPerSet = std::max(1u, (Problem.NumBits + 63) / 64);
+	size_t TotalWords = size_t(NumNodes) * WordsPerSet;
+	InSets.assign(TotalWords, 0);
+	OutSets.assign(TotalWords, 0);
+	if (Problem.usesGenKill()) {
+		GenSets.assign(TotalWords, 0);
+		KillSets.assign(TotalWords, 0);
+		for (Node* N : G.getAbstractedNodes()) {
+			Problem.getGenKill(N, getSet(GenSets, N->Id),
+					   getSet(KillSets, N->Id));
+		}
+	}
+}
+
+void DataFlowSolver::fill(BitSetRef Set) {
+	uint64_t* Words = Set.data();
+	std::fill(Words, Words + WordsPerSet, ~uint64_t(0));
+	if (Problem.NumBits % 64) {
+		Words[Problem.NumBits / 64] = (uint64_t(1) << (Problem.NumBits % 64)) - 1;
+	}
+	for (unsigned W = (Problem.NumBits + 63) / 64; W < WordsPerSet; W++) {
+		Words[W] = 0;
+	}
+}
+
+/* computeOrder
+ * Iterative depth first search from the entry (forward) or the exit
+ * (backward) node over the compact layout
+ */
+void DataFlowSolver::computeOrder(const CompactCFG& C) {
+	bool Forward = Problem.Direction == forward;
+	std::vector<bool> Visited(NumNodes, false);
+	std::vector<uint32_t> PostOrder;
+	PostOrder.reserve(NumNodes);
+	// Node and the position of the next edge to follow
+	std::vector<std::pair<uint32_t, unsigned>> Stack;
+	uint32_t Root = Forward ? C.getStart() : C.getEnd();
+	Visited[Root] = true;
+	Stack.push_back({Root, 0});
+	while (!Stack.empty()) {
+		uint32_t N = Stack.back().first;
+		ArrayRef<uint32_t> Next = Forward ? C.getSucc(N) : C.getPred(N);
+		if (Stack.back().second < Next.size()) {
+			uint32_t S = Next[Stack.back().second++];
+			if (!Visited[S]) {
+				Visited[S] = true;
+				Stack.push_back({S, 0});
+			}
+			continue;
+		}
+		PostOrder.push_back(N);
+		Stack.pop_back();
+	}
+	Order.assign(PostOrder.rbegin(), PostOrder.rend());
+	for (uint32_t N = 0; N < NumNodes; N++) {
+		if (!Visited[N]) {
+			Order.push_back(N);
+		}
+	}
+}
+
+/* solve
+ * Worklist iteration. The worklist is a priority queue on the position of
+ * the node in reverse post order so that a node is visited after the nodes
+ * flowing into it whenever possible. Every node is visited at least once.
+ */
+void DataFlowSolver::solve() {
+	if (NumNodes == 0) {
+		return;
+	}
+	TimeTraceScope Scope("DataFlowSolver::solve", [&] {
+		return G.getStartNode()->Inst->getFunction()->getName().str();
+	});
+	const CompactCFG& C = G.getCompactCFG();
+	const NodeList& Nodes = G.getAbstractedNodes();
+	bool Forward = Problem.Direction == forward;
+	bool Union = Problem.Meet == meetUnion;
+	computeOrder(C);
+	std::vector<uint32_t> Priority(NumNodes);
+	for (uint32_t I = 0; I < NumNodes; I++) {
+		Priority[Order[I]] = I;
+	}
+	// Sets flowing into the nodes start from the boundary value or the top
+	// element of the meet, the other sets from the top element
+	uint32_t Boundary = Forward ? C.getStart() : C.getEnd();
+	std::vector<uint64_t>& MeetSets = Forward ? InSets : OutSets;
+	std::vector<uint64_t>& TransferSets = Forward ? OutSets : InSets;
+	if (!Union) {
+		for (uint32_t N = 0; N < NumNodes; N++) {
+			fill(getSet(MeetSets, N));
+			fill(getSet(TransferSets, N));
+		}
+	}
+	BitSetRef BoundarySet = getSet(MeetSets, Boundary);
+	std::fill(BoundarySet.data(), BoundarySet.data() + WordsPerSet, 0);
+	Problem.initBoundary(BoundarySet);
+
+	std::priority_queue<uint32_t, std::vector<uint32_t>,
+			    std::greater<uint32_t>>
+	    WorkList;
+	std::vector<bool> InWorkList(NumNodes, true);
+	for (uint32_t I = 0; I < NumNodes; I++) {
+		WorkList.push(I);
+	}
+	while (!WorkList.empty()) {
+		uint32_t N = Order[WorkList.top()];
+		WorkList.pop();
+		InWorkList[N] = false;
+		NumVisits++;
+		BitSetRef MeetSet = getSet(MeetSets, N);
+		ArrayRef<uint32_t> Sources = Forward ? C.getPred(N) : C.getSucc(N);
+		// The boundary keeps its value, other nodes meet their sources
+		if (N != Boundary) {
+			if (Union) {
+				std::fill(MeetSet.data(),
+					  MeetSet.data() + WordsPerSet, 0);
+			} else {
+				fill(MeetSet);
+			}
+			for (uint32_t S : Sources) {
+				const uint64_t* Src =
+				    getSet(TransferSets, S).data();
+				if (Union) {
+					bitset::unionWith(MeetSet.data(), Src,
+							  WordsPerSet);
+				} else {
+					bitset::intersectWith(MeetSet.data(),
+							      Src, WordsPerSet);
+				}
+			}
+		}
+		BitSetRef TransferSet = getSet(TransferSets, N);
+		bool Changed;
+		if (Problem.usesGenKill()) {
+			Changed = bitset::transfer(
+			    TransferSet.data(), MeetSet.data(),
+			    getSet(GenSets, N).data(),
+			    getSet(KillSets, N).data(), WordsPerSet);
+		} else {
+			Changed = Problem.transfer(Nodes[N], MeetSet,
+						   TransferSet);
+		}
+		if (!Changed) {
+			continue;
+		}
+		for (uint32_t T : Forward ? C.getSucc(N) : C.getPred(N)) {
+			if (!InWorkList[T]) {
+				InWorkList[T] = true;
+				WorkList.push(Priority[T]);
+			}
+		}
+	}
+}
+
+Value* getVariable(const Expression* Exp) {
+	if (!Exp || Exp->symbol == constant || Exp->symbol == newObj) {
+		return nullptr;
+	}
+	if (Exp->base) {
+		return Exp->base;
+	}
+	return Exp->functionArg;
+}
+
+const unsigned VariableIndex::NoId;
+
+unsigned VariableIndex::insert(Value* V) {
+	auto Inserted = Ids.insert({V, Vars.size()});
+	if (Inserted.second) {
+		Vars.push_back(V);
+	}
+	return Inserted.first->second;
+}
+
+// Variable read by an expression, &x takes the address of x without reading
+// it. RHSisAddress only tells that the value is a pointer, q = p reads p.
+static Value* getReadVariable(const Expression* Exp) {
+	if (!Exp || Exp->symbol == address) {
+		return nullptr;
+	}
+	return getVariable(Exp);
+}
+
+// Pointer dereferenced to reach the location written by a left hand side
+static Value* getDereferencedVariable(const Expression* Exp) {
+	if (Exp->symbol == pointer || Exp->symbol == arrow) {
+		return getVariable(Exp);
+	}
+	return nullptr;
+}
+
+LivenessAnalysis::LivenessAnalysis(CFG& G)
+    : DataFlowProblem(backward, meetUnion, 0) {
+	for (Node* N : G.getAbstractedNodes()) {
+		if (N->abstractedInto == update) {
+			if (Value* V = getVariable(N->LHS)) {
+				Variables.insert(V);
+			}
+			if (Value* V = getReadVariable(N->RHS)) {
+				Variables.insert(V);
+			}
+		} else if (N->abstractedInto == call) {
+			if (Value* V = getReadVariable(N->Callee)) {
+				Variables.insert(V);
+			}
+		}
+	}
+	NumBits = Variables.size();
+	Solver = std::make_unique<DataFlowSolver>(G, *this);
+	Solver->solve();
+}
+
+void LivenessAnalysis::getGenKill(Node* N, BitSetRef Gen, BitSetRef Kill) {
+	if (N->abstractedInto == call) {
+		if (Value* V = getReadVariable(N->Callee)) {
+			Gen.set(Variables.lookup(V));
+		}
+		return;
+	}
+	if (N->abstractedInto != update) {
+		return;
+	}
+	if (Value* V = getReadVariable(N->RHS)) {
+		Gen.set(Variables.lookup(V));
+	}
+	if (Value* V = getDereferencedVariable(N->LHS)) {
+		Gen.set(Variables.lookup(V));
+	} else if (N->LHS->symbol == simple) {
+		if (Value* V = getVariable(N->LHS)) {
+			Kill.set(Variables.lookup(V));
+		}
+	}
+}
+
+bool LivenessAnalysis::isLiveIn(Node* N, Value* V) {
+	unsigned Id = Variables.lookup(V);
+	return Id != VariableIndex::NoId && getLiveIn(N).test(Id);
+}
+
+bool LivenessAnalysis::isLiveOut(Node* N, Value* V) {
+	unsigned Id = Variables.lookup(V);
+	return Id != VariableIndex::NoId && getLiveOut(N).test(Id);
+}
+
+ReachingDefinitions::ReachingDefinitions(CFG& G)
+    : DataFlowProblem(forward, meetUnion, 0) {
+	for (Node* N : G.getAbstractedNodes()) {
+		if (N->abstractedInto != update) {
+			continue;
+		}
+		if (Value* V = getVariable(N->LHS)) {
+			Variables.insert(V);
+			DefIds[N] = Definitions.size();
+			Definitions.push_back(N);
+		}
+	}
+	NumBits = Definitions.size();
+	WordsPerSet = std::max(1u, (NumBits + 63) / 64);
+	DefsOfVariable.assign(size_t(Variables.size()) * WordsPerSet, 0);
+	for (unsigned Id = 0; Id < Definitions.size(); Id++) {
+		unsigned Var =
+		    Variables.lookup(getVariable(Definitions[Id]->LHS));
+		BitSetRef(DefsOfVariable.data() + size_t(Var) * WordsPerSet,
+			  WordsPerSet)
+		    .set(Id);
+	}
+	Solver = std::make_unique<DataFlowSolver>(G, *this);
+	Solver->solve();
+}
+
+void ReachingDefinitions::getGenKill(Node* N, BitSetRef Gen, BitSetRef Kill) {
+	auto It = DefIds.find(N);
+	if (It == DefIds.end()) {
+		return;
+	}
+	Gen.set(It->second);
+	if (N->LHS->symbol == simple) {
+		unsigned Var = Variables.lookup(getVariable(N->LHS));
+		bitset::unionWith(
+		    Kill.data(), DefsOfVariable.data() + size_t(Var) * WordsPerSet,
+		    WordsPerSet);
+	}
+}
+
+// Prints the variables of a set of the liveness as operands
+static void printVariables(raw_ostream& OS, StringRef Label, BitSetRef Set,
+			   const VariableIndex& Variables) {
+	OS << "    " << Label << ":";
+	Set.forEach([&](unsigned Id) {
+		OS << " ";
+		Variables.getVariable(Id)->printAsOperand(OS, false);
+	});
+	OS << "\n";
+}
+
+// Prints the nodes of a set of reaching definitions
+static void printDefinitions(raw_ostream& OS, StringRef Label, BitSetRef Set,
+			     const ReachingDefinitions& Reaching) {
+	OS << "    " << Label << ":";
+	Set.forEach([&](unsigned Id) {
+		OS << " " << Reaching.getDefinition(Id)->Id;
+	});
+	OS << "\n";
+}
+
+PreservedAnalyses DataFlowPrinterPass::run(Module& M,
+					   ModuleAnalysisManager& MAM) {
+	IRPlusPlusInfo& Info = MAM.getResult<IRPlusPlusAnalysis>(M).getInfo();
+	for (Function& F : M) {
+		CFG* G = F.isDeclaration() ? nullptr : Info.getCFG(&F);
+		if (!G || !G->getStartNode()) {
+			continue;
+		}
+		LivenessAnalysis Liveness(*G);
+		ReachingDefinitions Reaching(*G);
+		OS << "Dataflow of " << F.getName() << ":\n";
+		for (Node* N : G->getAbstractedNodes()) {
+			OS << "  node " << N->Id << ":";
+			if (N->Inst) {
+				OS << *N->Inst << "\n";
+			} else {
+				OS << " exit\n";
+			}
+			printVariables(OS, "live-in", Liveness.getLiveIn(N),
+				       Liveness.getVariables());
+			printVariables(OS, "live-out", Liveness.getLiveOut(N),
+				       Liveness.getVariables());
+			printDefinitions(OS, "reaching-in",
+					 Reaching.getReachingIn(N), Reaching);
+			printDefinitions(OS, "reaching-out",
+					 Reaching.getReachingOut(N), Reaching);
+		}
+	}
+	return PreservedAnalyses::all();
+}
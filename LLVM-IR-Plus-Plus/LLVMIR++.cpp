@@ -1,10 +1,17 @@
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <iterator>
 #include <memory>
+#include <thread>
 #include <utility>
 #include <vector>
 #include "include/LLVMIR++.h"
+#include "include/Cache.h"
+#include "include/DataFlow.h"
+#include "include/PointsTo.h"
+#include "include/ResultWriter.h"
+#include "include/VFCR.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/STLExtras.h"
@@ -12,13 +19,16 @@
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/iterator_range.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/IR/Argument.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/CFG.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/DiagnosticInfo.h"
 #include "llvm/IR/AbstractCallSite.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/InstrTypes.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Instructions.h"
@@ -27,13 +37,17 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
 #include "llvm/IR/Use.h"
 #include "llvm/IR/User.h"
 #include "llvm/IR/Value.h"
 #include "llvm/Pass.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/TimeProfiler.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
 #include "llvm/Transforms/Utils/Local.h"
@@ -42,9 +56,82 @@ using namespace llvm;
 
 #define DEBUG_TYPE "llvmir++"
 
-Instruction * resolveBase(Instruction * Inst);
-Instruction *handleGEP(GetElementPtrInst* Inst);
-std::vector<GetElementPtrInst*> GEPVec; 
+// Counted with NDEBUG as well, llvmir++-tool prints them on any build
+ALWAYS_ENABLED_STATISTIC(NumStores, "Number of stores abstracted");
+ALWAYS_ENABLED_STATISTIC(NumLHSSimple, "Number of stores to x");
+ALWAYS_ENABLED_STATISTIC(NumLHSPointer, "Number of stores to *x");
+ALWAYS_ENABLED_STATISTIC(NumLHSArrow, "Number of stores to x -> f");
+ALWAYS_ENABLED_STATISTIC(NumLHSDot, "Number of stores to x.f");
+ALWAYS_ENABLED_STATISTIC(NumRHSSimple, "Number of stores of y");
+ALWAYS_ENABLED_STATISTIC(NumRHSPointer, "Number of stores of *y");
+ALWAYS_ENABLED_STATISTIC(NumRHSArrow, "Number of stores of y -> f");
+ALWAYS_ENABLED_STATISTIC(NumRHSDot, "Number of stores of y.f");
+ALWAYS_ENABLED_STATISTIC(NumRHSConstant, "Number of stores of a constant");
+ALWAYS_ENABLED_STATISTIC(NumRHSAddress, "Number of stores of &y");
+ALWAYS_ENABLED_STATISTIC(NumRHSNewObj, "Number of stores of a new object");
+ALWAYS_ENABLED_STATISTIC(
+    NumLHSFallbacks,
+    "Number of store destinations that fell back to functionArg");
+ALWAYS_ENABLED_STATISTIC(
+    NumRHSFallbacks, "Number of stored values that fell back to functionArg");
+ALWAYS_ENABLED_STATISTIC(NumFieldPaths, "Number of distinct field paths");
+ALWAYS_ENABLED_STATISTIC(
+    NumGEPsDeduplicated,
+    "Number of GEPs folded into the GEP of the same field path");
+ALWAYS_ENABLED_STATISTIC(NumDirectCalls, "Number of direct calls");
+ALWAYS_ENABLED_STATISTIC(NumIndirectCalls, "Number of indirect calls");
+ALWAYS_ENABLED_STATISTIC(NumVirtualCalls, "Number of virtual calls");
+ALWAYS_ENABLED_STATISTIC(NumIntrinsicCalls, "Number of intrinsic calls");
+ALWAYS_ENABLED_STATISTIC(
+    NumCacheHits, "Number of functions restored from the summary cache");
+
+static cl::opt<unsigned> Threads(
+    "llvmir++-threads",
+    cl::desc("Number of threads generating metadata and cfgs of functions "
+	     "(0 uses all the hardware threads)"),
+    cl::init(1));
+
+static cl::opt<bool> Lazy(
+    "llvmir++-lazy",
+    cl::desc("Generate metadata and cfgs only when a function or a store is "
+	     "queried"),
+    cl::init(false));
+
+static cl::opt<std::string> CacheDir(
+    "llvmir++-cache-dir",
+    cl::desc("Directory of the cache of the analyzed functions, functions "
+	     "found in it are not analyzed again"),
+    cl::init(""));
+
+static cl::opt<std::string> EmitBinary(
+    "llvmir++-emit-binary",
+    cl::desc("Write the metadata and the cfgs of the module to this file in "
+	     "the binary result format"),
+    cl::value_desc("file"), cl::init(""));
+
+static cl::opt<std::string> EmitJSON(
+    "llvmir++-emit-json",
+    cl::desc("Stream the statements and the cfg edges of the module to this "
+	     "file as JSON Lines (- is stdout)"),
+    cl::value_desc("file"), cl::init(""));
+
+static cl::opt<std::string> TimeTrace(
+    "llvmir++-time-trace",
+    cl::desc("Write a Chrome trace of the phases of the analysis, a span per "
+	     "function and a lane per thread"),
+    cl::value_desc("file"), cl::init(""));
+
+static cl::opt<unsigned> TimeTraceGranularity(
+    "llvmir++-time-trace-granularity",
+    cl::desc("Spans shorter than this many microseconds are left out of the "
+	     "trace"),
+    cl::init(500));
+
+static cl::opt<bool> TrackChanges(
+    "llvmir++-track-changes",
+    cl::desc("Watch the analyzed IR with value handles and invalidate only "
+	     "the functions that are modified"),
+    cl::init(false));
 
 /* resetMetadata
  * Reset all Expression class member to their initial value
@@ -118,6 +205,60 @@ bool Expression::ExpEqual::operator()(Expression const* exp1,
 	return true;
 }
 
+/* ExpHash
+ * Hashes all the data member of an Expression, structurally equal expressions
+ * have the same hash
+ */
+size_t Expression::ExpHash::operator()(Expression const* exp) const {
+	return hash_combine(exp->base, exp->optional, exp->type, exp->symbol,
+			    exp->functionArg, exp->RHSisAddress);
+}
+
+Expression* ExpressionPool::ExpInfo::getEmptyKey() {
+	return DenseMapInfo<Expression*>::getEmptyKey();
+}
+
+Expression* ExpressionPool::ExpInfo::getTombstoneKey() {
+	return DenseMapInfo<Expression*>::getTombstoneKey();
+}
+
+unsigned ExpressionPool::ExpInfo::getHashValue(const Expression* exp) {
+	return Expression::ExpHash()(exp);
+}
+
+bool ExpressionPool::ExpInfo::isEqual(const Expression* exp1,
+				      const Expression* exp2) {
+	if (exp1 == exp2) {
+		return true;
+	}
+	// Empty and tombstone keys are only equal to themselves
+	if (exp1 == getEmptyKey() || exp1 == getTombstoneKey() ||
+	    exp2 == getEmptyKey() || exp2 == getTombstoneKey()) {
+		return false;
+	}
+	return Expression::ExpEqual()(exp1, exp2);
+}
+
+ExpressionPool::ExpressionPool(Arena& IRArena) : Allocator(IRArena) {}
+
+/* intern
+ * Returns the canonical copy of Exp, the copy is created on the first request
+ * for a shape and reused for all the later ones
+ */
+Expression* ExpressionPool::intern(Expression Exp) {
+	if (GetElementPtrInst* GEP =
+		dyn_cast_or_null<GetElementPtrInst>(Exp.optional)) {
+		Exp.optional = Fields.handleGEP(GEP);
+	}
+	auto It = Pool.find_as(&Exp);
+	if (It != Pool.end()) {
+		return *It;
+	}
+	Expression* Canonical = Allocator.create<Expression>(&Exp);
+	Pool.insert(Canonical);
+	return Canonical;
+}
+
 /* Constructor for LHSExpression
  * For an input Value* Exp it generates a LHSExpression object for it
  * It resets meta data and uses getMetaData to abstract meta data
@@ -168,7 +309,9 @@ void LHSExpression::getMetaData(Value* Exp) {
 			       dyn_cast<GetElementPtrInst>(PreInst)) {
 			// check if instruction is of type x.f = ... or
 			// x -> f = ...
-			optional = handleGEP(PreGEPInst);
+			// the field is canonicalized when the expression is
+			// interned
+			optional = PreGEPInst;
 			Value* RHSPreGEPInst;
 			for (auto& op : PreGEPInst->operands()) {
 				RHSPreGEPInst = op;
@@ -302,7 +445,9 @@ void RHSExpression::getMetaData(Value* Exp) {
 			// check if instruction is of type x.f = ... or
 			// x -> f =
 			// ...
-			optional = handleGEP(PreGEPInst);
+			// the field is canonicalized when the expression is
+			// interned
+			optional = PreGEPInst;
 			Value* RHSPreGEPInst;
 			for (auto& op : cast<User>(PreGEPInst)->operands()) {
 				RHSPreGEPInst = op;
@@ -363,6 +508,10 @@ void RHSExpression::getMetaData(Value* Exp) {
 		// example LHS = RHS then type of LHS and RHS are needed
 		// to be same LHS = RHS1 + RHS2 + ... then type of LHS
 		// and RHSi would be same
+		// The operands of a phi in a loop lead back to it
+		if (!Visited.insert(Exp).second) {
+			return;
+		}
 		for (auto& op : cast<User>(Exp)->operands()) {
 			getMetaData(op);
 		}
@@ -378,17 +527,95 @@ void RHSExpression::getMetaData(Value* Exp) {
  * It abstract meta data of format LHS = RHS
  * which is object of class UpdateInst
  */
-UpdateInst::UpdateInst(StoreInst* I) {
+RawUpdateInst::RawUpdateInst(StoreInst* I) {
 	LLVM_DEBUG(dbgs() << " 	UpdateI object initialized with " << *I
 			  << "\n";);
+	Inst = I;
 	// Get the LHS value of the store instruction
 	Value* StoreInstLHS = I->getPointerOperand();
 	// Generate LHS meta data
-	LHS = new LHSExpression(StoreInstLHS);
+	LHS = LHSExpression(StoreInstLHS);
 	// Get the RHS value of the store instruction
 	Value* StoreInstRHS = I->getValueOperand();
 	// Generate RHS meta data
-	RHS = new RHSExpression(StoreInstRHS);
+	RHS = RHSExpression(StoreInstRHS);
+	// A pointer stored into a variable of different type is the address of
+	// the RHS ie x = &y
+	if (RHS.symbol != newObj && RHS.RHSisAddress && LHS.RHSisAddress &&
+	    (RHS.type != LHS.type) && LHS.symbol != pointer) {
+		RHS.symbol = address;
+	}
+}
+
+UpdateInst::UpdateInst(StoreInst* I, ExpressionPool& Expressions)
+    : UpdateInst(RawUpdateInst(I), Expressions) {}
+
+UpdateInst::UpdateInst(const RawUpdateInst& Raw, ExpressionPool& Expressions) {
+	Inst = Raw.Inst;
+	// Canonical expressions are shared, they are interned only after they
+	// are complete
+	LHS = Expressions.intern(Raw.LHS);
+	RHS = Expressions.intern(Raw.RHS);
+}
+
+/* Constructor for FunctionMetaData
+ * Abstracts every store and the receiver of every virtual call of F
+ */
+FunctionMetaData::FunctionMetaData(Function& F) {
+	// Iterate over basicblocks
+	for (BasicBlock& BB : F) {
+		// Iterate over Instructions
+		for (Instruction& I : BB) {
+			LLVM_DEBUG(dbgs() << ">>>> " << I << "\n";);
+			// For every store instruction
+			if (StoreInst* StoreI = dyn_cast<StoreInst>(&I)) {
+				LLVM_DEBUG(dbgs() << ">>>>>>>>	" << I << "\n";);
+				// Generate meta-data for store instruction
+				Updates.emplace_back(StoreI);
+			} else if (CallInst* CI = dyn_cast<CallInst>(&I)) {
+				if (!isVirtualCall(CI)) {
+					continue;
+				}
+				// The receiver is the object the virtual
+				// function is called on ie the this argument
+				LoadInst* inst = dyn_cast<LoadInst>(
+				    CI->getArgOperand(0));
+				if (!inst) {
+					continue;
+				}
+				RHSExpression Receiver(inst->getPointerOperand());
+				Receiver.base = resolveBase(Receiver.base);
+				Receivers.emplace_back(CI, Receiver);
+			}
+		}
+	}
+}
+
+/* isVirtualCall
+ * A virtual call loads the function from a slot of the vtable which is itself
+ * loaded from the object
+ *	%vtable = load %obj
+ *	%vfn = getelementptr %vtable, slot
+ *	%f = load %vfn
+ *	call %f(%obj, ...)
+ */
+bool isVirtualCall(CallInst* CI) {
+	if (CI->getCalledFunction() || CI->arg_size() == 0) {
+		return false;
+	}
+	Value* virtFunc = CI->getCalledOperand();
+	if (LoadInst* virtFuncLoadInst = dyn_cast<LoadInst>(virtFunc)) {
+		Value* virtFuncPtr = virtFuncLoadInst->getPointerOperand();
+		if (GetElementPtrInst* virtFuncPtrGEPInst =
+			dyn_cast<GetElementPtrInst>(virtFuncPtr)) {
+			if (virtFuncPtrGEPInst->getNumIndices() == 1) {
+				Value* virtTable =
+				    virtFuncPtrGEPInst->getPointerOperand();
+				return isa<LoadInst>(virtTable);
+			}
+		}
+	}
+	return false;
 }
 
 void UpdateInst::print() {
@@ -433,34 +660,485 @@ void Expression::print() {
 	}
 }
 
-LLVMIRPlusPlusPass::LLVMIRPlusPlusPass() : ModulePass(ID) {}
+/* insert
+ * Adds the meta data of a store instruction, a store instruction which
+ * already has meta data keeps its index and gets the new meta data
+ */
+void MetaDataStore::insert(UpdateInst* UpdateI) {
+	auto Inserted = Index.insert({UpdateI->Inst, Updates.size()});
+	if (!Inserted.second) {
+		Updates[Inserted.first->second] = UpdateI;
+		return;
+	}
+	Updates.push_back(UpdateI);
+}
 
-bool LLVMIRPlusPlusPass::runOnModule(Module& M) {
+UpdateInst* MetaDataStore::lookup(StoreInst* StoreI) const {
+	auto It = Index.find(StoreI);
+	if (It == Index.end()) {
+		return nullptr;
+	}
+	return Updates[It->second];
+}
+
+/* erase
+ * The last store takes the index of the erased one
+ */
+UpdateInst* MetaDataStore::erase(StoreInst* StoreI) {
+	auto It = Index.find(StoreI);
+	if (It == Index.end()) {
+		return nullptr;
+	}
+	unsigned Idx = It->second;
+	UpdateInst* UpdateI = Updates[Idx];
+	Index.erase(It);
+	if (Idx != Updates.size() - 1) {
+		Updates[Idx] = Updates.back();
+		Index[Updates[Idx]->Inst] = Idx;
+	}
+	Updates.pop_back();
+	return UpdateI;
+}
+
+void MetaDataStore::insertReceiver(CallInst* CI, Expression* Receiver) {
+	Receivers[CI] = Receiver;
+}
+
+void MetaDataStore::eraseReceiver(CallInst* CI) { Receivers.erase(CI); }
+
+Expression* MetaDataStore::lookupReceiver(CallInst* CI) const {
+	return Receivers.lookup(CI);
+}
+
+void MetaDataStore::clear() {
+	Index.clear();
+	Updates.clear();
+	Receivers.clear();
+}
+
+/* parallelFor
+ * Runs Body(0) .. Body(N - 1) on NumThreads threads. Indices are handed out
+ * one at a time so that a few large functions do not stall the other threads.
+ */
+void parallelFor(unsigned NumThreads, size_t N,
+		 function_ref<void(size_t)> Body) {
+	std::atomic<size_t> Next(0);
+	auto Worker = [&]() {
+		for (size_t I = Next++; I < N; I = Next++) {
+			Body(I);
+		}
+	};
+	// The time profiler is per thread, every worker records its own lane
+	// and hands it to the profiler of the trace when it is done
+	bool Trace = timeTraceProfilerEnabled();
+	auto TracedWorker = [&]() {
+		timeTraceProfilerInitialize(TimeTraceGranularity, "llvmir++");
+		Worker();
+		timeTraceProfilerFinishThread();
+	};
+	std::vector<std::thread> Workers;
+	for (unsigned T = 1; T < NumThreads && T < N; T++) {
+		if (Trace) {
+			Workers.emplace_back(TracedWorker);
+		} else {
+			Workers.emplace_back(Worker);
+		}
+	}
+	Worker();
+	for (std::thread& W : Workers) {
+		W.join();
+	}
+}
+
+IRPlusPlusInfo::IRPlusPlusInfo() : Expressions(IRArena) {}
+
+// A global variable is kept in functionArg as well but it is not a fallback
+static bool isFallback(const Expression& Exp) {
+	return Exp.functionArg && !isa<GlobalVariable>(Exp.functionArg);
+}
+
+static void countStatistics(const RawUpdateInst& Raw) {
+	++NumStores;
+	switch (Raw.LHS.symbol) {
+	case simple: ++NumLHSSimple; break;
+	case pointer: ++NumLHSPointer; break;
+	case arrow: ++NumLHSArrow; break;
+	case dot: ++NumLHSDot; break;
+	default: break;
+	}
+	switch (Raw.RHS.symbol) {
+	case simple: ++NumRHSSimple; break;
+	case pointer: ++NumRHSPointer; break;
+	case arrow: ++NumRHSArrow; break;
+	case dot: ++NumRHSDot; break;
+	case constant: ++NumRHSConstant; break;
+	case address: ++NumRHSAddress; break;
+	case newObj: ++NumRHSNewObj; break;
+	}
+	if (isFallback(Raw.LHS)) {
+		++NumLHSFallbacks;
+	}
+	if (isFallback(Raw.RHS)) {
+		++NumRHSFallbacks;
+	}
+}
+
+/* countStatistics
+ * Counts the stores and the calls of a function once its metadata is
+ * committed. Calls are classified like the call nodes of its cfg.
+ */
+static void countStatistics(Function& F, const FunctionMetaData& FMD) {
+	for (const RawUpdateInst& Raw : FMD.Updates) {
+		countStatistics(Raw);
+	}
+	for (Instruction& I : instructions(F)) {
+		CallInst* CI = dyn_cast<CallInst>(&I);
+		if (!CI) {
+			continue;
+		}
+		Function* Called = CI->getCalledFunction();
+		if (Called && Called->isIntrinsic()) {
+			++NumIntrinsicCalls;
+		} else if (Called) {
+			++NumDirectCalls;
+		} else if (isVirtualCall(CI)) {
+			++NumVirtualCalls;
+		} else {
+			++NumIndirectCalls;
+		}
+	}
+}
+
+// Unnamed values are named like operands in the IR, eg %5
+static std::string getOperandName(const Value* V) {
+	std::string Name;
+	raw_string_ostream OS(Name);
+	V->printAsOperand(OS, false);
+	return OS.str();
+}
+
+/* emitRemarks
+ * Reports the stores and the calls of F the analysis could not abstract as
+ * missed remarks, eg for -pass-remarks-output. Arguments stored directly are
+ * abstracted as functionArg on purpose and are not reported. Nothing is done
+ * unless remarks of llvmir++ are requested.
+ */
+static void emitRemarks(Function& F, const FunctionMetaData& FMD) {
+	LLVMContext& Context = F.getContext();
+	if (!Context.getLLVMRemarkStreamer() &&
+	    !Context.getDiagHandlerPtr()->isAnyRemarkEnabled(DEBUG_TYPE)) {
+		return;
+	}
+	OptimizationRemarkEmitter ORE(&F);
+	for (const RawUpdateInst& Raw : FMD.Updates) {
+		if (isFallback(Raw.LHS)) {
+			ORE.emit(OptimizationRemarkMissed(DEBUG_TYPE,
+							  "StoreNotAbstracted",
+							  Raw.Inst)
+				 << "destination "
+				 << ore::NV("Pointer",
+					    getOperandName(Raw.LHS.functionArg))
+				 << " of the store is not abstracted");
+		}
+		if (isFallback(Raw.RHS) && !isa<Argument>(Raw.RHS.functionArg)) {
+			ORE.emit(OptimizationRemarkMissed(DEBUG_TYPE,
+							  "ValueNotAbstracted",
+							  Raw.Inst)
+				 << "stored value "
+				 << ore::NV("Value",
+					    getOperandName(Raw.RHS.functionArg))
+				 << " is not abstracted");
+		}
+	}
+	SmallPtrSet<CallInst*, 8> Receivers;
+	for (auto& Receiver : FMD.Receivers) {
+		Receivers.insert(Receiver.first);
+	}
+	for (Instruction& I : instructions(F)) {
+		CallInst* CI = dyn_cast<CallInst>(&I);
+		if (!CI || CI->getCalledFunction()) {
+			continue;
+		}
+		if (!isVirtualCall(CI)) {
+			ORE.emit(OptimizationRemarkMissed(DEBUG_TYPE,
+							  "IndirectCall", CI)
+				 << "callee of the indirect call is not "
+				    "resolved");
+		} else if (!Receivers.count(CI)) {
+			ORE.emit(OptimizationRemarkMissed(
+				     DEBUG_TYPE, "VirtualCallNoReceiver", CI)
+				 << "receiver of the virtual call is not "
+				    "found");
+		}
+	}
+}
+
+/* analyze
+ * Generates the metadata of every store and then the cfg of every function.
+ * With more than one thread the raw metadata and the cfgs of the functions
+ * are built on a pool of threads. The raw metadata is interned on the calling
+ * thread in the order of the functions, so the result does not depend on
+ * the number of threads.
+ */
+void IRPlusPlusInfo::analyze(Module& M, unsigned NumThreads) {
+	std::vector<Function*> Functions;
 	for (Function& F : M) {
-		// Iterate over basicblocks
-		for (BasicBlock& BB : F) {
-			// Iterate over Instructions
-			for (Instruction& I : BB) {
-				LLVM_DEBUG(dbgs() << ">>>> " << I << "\n";);
-				// For every store instruction
-				if (StoreInst* StoreI =
-					dyn_cast<StoreInst>(&I)) {
-					LLVM_DEBUG(dbgs() << ">>>>>>>>	" << I
-							  << "\n";);
-					// Generate meta-data for store
-					// instruction
-					generateMetaData(StoreI);
+		Functions.push_back(&F);
+	}
+	analyze(Functions, NumThreads);
+}
+
+void IRPlusPlusInfo::analyze(Function& F) {
+	analyze(ArrayRef<Function*>(&F), 1);
+}
+
+/* analyze
+ * The raw metadata is generated in parallel and interned in the order of the
+ * functions so that the result does not depend on the number of threads.
+ * Functions found in the cache skip generateMetaData and CFG::init, the
+ * others are added to the cache once their cfg is built.
+ */
+void IRPlusPlusInfo::analyze(ArrayRef<Function*> AllFunctions,
+			     unsigned NumThreads) {
+	if (NumThreads == 0) {
+		NumThreads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	TimeTraceScope AnalyzeScope("IRPlusPlusInfo::analyze");
+	std::vector<Function*> Functions;
+	for (Function* F : AllFunctions) {
+		// Declarations have no body and functions analyzed on demand
+		// are kept
+		if (!F->isDeclaration() && !grcfg.count(F)) {
+			Functions.push_back(F);
+		}
+	}
+	std::vector<std::unique_ptr<FunctionSummary>> Summaries(
+	    Functions.size());
+	std::vector<std::unique_ptr<FunctionMetaData>> Raw(Functions.size());
+	auto Generate = [&](size_t I) {
+		TimeTraceScope Scope("generateMetaData", [&] {
+			return Functions[I]->getName().str();
+		});
+		if (Cache) {
+			Summaries[I] = Cache->lookup(*Functions[I]);
+			if (Summaries[I]->Found) {
+				return;
+			}
+		}
+		Raw[I].reset(new FunctionMetaData(*Functions[I]));
+		if (Cache && !Cache->encode(*Functions[I], *Raw[I],
+					    *Summaries[I])) {
+			Summaries[I].reset();
+		}
+	};
+	auto Commit = [&](size_t I) {
+		FunctionMetaData& FMD = Raw[I] ? *Raw[I] : Summaries[I]->MetaData;
+		// Remarks go through the context, they are emitted by one thread
+		emitRemarks(*Functions[I], FMD);
+		// A function analyzed again, eg once it is updated, is not
+		// counted twice
+		if (Counted.insert(Functions[I]).second) {
+			countStatistics(*Functions[I], FMD);
+		}
+		commitMetaData(FMD);
+		Raw[I].reset();
+	};
+	if (NumThreads == 1) {
+		for (size_t I = 0; I < Functions.size(); I++) {
+			Generate(I);
+			Commit(I);
+		}
+	} else {
+		{
+			TimeTraceScope Scope("Generate metadata");
+			parallelFor(NumThreads, Functions.size(), Generate);
+		}
+		TimeTraceScope Scope("Commit metadata");
+		for (size_t I = 0; I < Functions.size(); I++) {
+			Commit(I);
+		}
+	}
+	// Nodes only read the metadata, the cfgs are independent of each other
+	std::vector<CFG*> CFGs;
+	for (Function* Func : Functions) {
+		CFGs.push_back(createCFG(Func));
+	}
+	TimeTraceScope CFGScope("Build cfgs");
+	parallelFor(NumThreads, Functions.size(), [&](size_t I) {
+		TimeTraceScope Scope("CFG", [&] {
+			return Functions[I]->getName().str();
+		});
+		FunctionSummary* Summary = Summaries[I].get();
+		if (Summary && Summary->Found &&
+		    CFGs[I]->restore(Functions[I], IRPlusPlus, Summary->Shape)) {
+			++NumCacheHits;
+			return;
+		}
+		CFGs[I]->init(Functions[I], IRPlusPlus);
+		if (Summary && !Summary->Found) {
+			Cache->store(*Summary, *CFGs[I]);
+		}
+	});
+	for (Function* Func : Functions) {
+		Dirty.remove(Func);
+		watch(Func);
+	}
+}
+
+CFG* IRPlusPlusInfo::createCFG(Function* Func) {
+	CFG* cfg;
+	if (!FreeCFGs.empty()) {
+		cfg = FreeCFGs.back();
+		FreeCFGs.pop_back();
+	} else {
+		cfg = new (CFGAllocator.Allocate()) CFG();
+	}
+	grcfg[Func] = cfg;
+	return cfg;
+}
+
+/* watch
+ * The cfg of F depends on all its instructions, its metadata also depends on
+ * the values the expressions refer to eg globals or canonical GEPs of other
+ * functions
+ */
+void IRPlusPlusInfo::watch(Function* F) {
+	if (!TrackChanges) {
+		return;
+	}
+	CFG* cfg = grcfg[F];
+	SmallPtrSet<Value*, 32> Watched;
+	std::vector<DependencyVH>& Deps = Dependencies[F];
+	Deps.clear();
+	auto Watch = [&](Value* V) {
+		if (V && Watched.insert(V).second) {
+			Deps.emplace_back(V, this, F);
+		}
+	};
+	auto WatchExp = [&](Expression* Exp) {
+		if (Exp) {
+			Watch(Exp->base);
+			Watch(Exp->optional);
+			Watch(Exp->functionArg);
+		}
+	};
+	Watch(F);
+	for (Node* N : cfg->getNodes()) {
+		Watch(N->Inst);
+		WatchExp(N->LHS);
+		WatchExp(N->RHS);
+		WatchExp(N->Callee);
+	}
+}
+
+/* drop
+ * Forgets the metadata and the cfg of F, the statements and the cfg are kept
+ * for reuse. The canonical expressions may be shared with other functions
+ * and are not dropped.
+ */
+void IRPlusPlusInfo::drop(Function* F) {
+	auto It = grcfg.find(F);
+	if (It != grcfg.end()) {
+		CFG* cfg = It->second;
+		for (Node* N : cfg->getNodes()) {
+			if (StoreInst* StoreI =
+				dyn_cast_or_null<StoreInst>(N->Inst)) {
+				if (UpdateInst* UpdateI =
+					IRPlusPlus.erase(StoreI)) {
+					FreeUpdates.push_back(UpdateI);
 				}
+			} else if (N->callType == virt) {
+				IRPlusPlus.eraseReceiver(
+				    cast<CallInst>(N->Inst));
 			}
 		}
+		cfg->clear();
+		FreeCFGs.push_back(cfg);
+		grcfg.erase(It);
 	}
-	for (Function& F : M) {
-		Function* Func = &F;
-		CFG* cfg = new CFG();
-		cfg->init(Func, IRPlusPlus);
-		grcfg[Func] = &*cfg;
+	// This may destroy the value handle that is calling us
+	Dependencies.erase(F);
+}
+
+/* invalidate
+ * Drops the metadata and the cfg of F. The instructions of F are not walked,
+ * F may be in the middle of being deleted, the nodes of the cfg tell which
+ * stores and calls belong to F.
+ */
+void IRPlusPlusInfo::invalidate(Function* F, bool Deleted) {
+	drop(F);
+	if (Deleted) {
+		Counted.erase(F);
+		Dirty.remove(F);
+		return;
 	}
-	return false;
+	Dirty.insert(F);
+	// A dirty function is still watched so that it is dropped if it is
+	// deleted before the next update
+	if (TrackChanges) {
+		Dependencies[F].emplace_back(F, this, F);
+	}
+}
+
+void IRPlusPlusInfo::release(Function* F) {
+	drop(F);
+	Dirty.remove(F);
+}
+
+void IRPlusPlusInfo::update() {
+	// analyze removes the function from Dirty
+	SmallVector<Function*, 8> Worklist(Dirty.begin(), Dirty.end());
+	for (Function* F : Worklist) {
+		analyze(*F);
+	}
+}
+
+void DependencyVH::deleted() {
+	// Members must not be touched once invalidate destroyed this handle
+	Info->invalidate(F, getValPtr() == F);
+}
+
+void DependencyVH::allUsesReplacedWith(Value*) { Info->invalidate(F); }
+
+/* getCFG
+ * Returns the memoized cfg of F, analyzing F first if it was never requested.
+ * Analyzing on demand is not thread safe.
+ */
+CFG* IRPlusPlusInfo::getCFG(Function* F) {
+	auto It = grcfg.find(F);
+	if (It != grcfg.end()) {
+		return It->second;
+	}
+	if (F->isDeclaration()) {
+		return nullptr;
+	}
+	analyze(*F);
+	return grcfg[F];
+}
+
+UpdateInst* IRPlusPlusInfo::getMetaData(StoreInst* StoreI) {
+	if (UpdateInst* UpdateI = IRPlusPlus.lookup(StoreI)) {
+		return UpdateI;
+	}
+	generateMetaData(StoreI);
+	return IRPlusPlus.lookup(StoreI);
+}
+
+/* clear
+ * All the Expression, UpdateInst, Node and CFG objects are owned by the
+ * IRPlusPlusInfo and are freed together
+ */
+void IRPlusPlusInfo::clear() {
+	Dependencies.clear();
+	Dirty.clear();
+	Counted.clear();
+	FreeCFGs.clear();
+	FreeUpdates.clear();
+	grcfg.clear();
+	CFGAllocator.DestroyAll();
+	IRPlusPlus.clear();
+	Expressions.clear();
+	IRArena.reset();
 }
 
 /* generateMetaData
@@ -468,28 +1146,51 @@ bool LLVMIRPlusPlusPass::runOnModule(Module& M) {
  * It init an object of UpdateInst which in turn generate metadata for
  * LHS and RHS
  */
-void LLVMIRPlusPlusPass::generateMetaData(StoreInst* StoreI) {
+void IRPlusPlusInfo::generateMetaData(StoreInst* StoreI) {
 	if (StoreI == nullptr) {
 		return;
 	}
-	UpdateInst* UpdateI = new UpdateInst(StoreI);
-	if (UpdateI == nullptr) {
-		return;
+	commitMetaData(RawUpdateInst(StoreI));
+}
+
+/* commitMetaData
+ * Interns the raw metadata of a function, stores and receivers keep the order
+ * of the instructions
+ */
+void IRPlusPlusInfo::commitMetaData(FunctionMetaData& FMD) {
+	for (RawUpdateInst& Raw : FMD.Updates) {
+		// Stores queried on demand keep their metadata
+		if (!IRPlusPlus.lookup(Raw.Inst)) {
+			commitMetaData(Raw);
+		}
+	}
+	for (auto& Receiver : FMD.Receivers) {
+		IRPlusPlus.insertReceiver(Receiver.first,
+					  Expressions.intern(Receiver.second));
+	}
+}
+
+void IRPlusPlusInfo::commitMetaData(const RawUpdateInst& Raw) {
+	UpdateInst* UpdateI;
+	if (!FreeUpdates.empty()) {
+		UpdateI = new (FreeUpdates.back()) UpdateInst(Raw, Expressions);
+		FreeUpdates.pop_back();
+	} else {
+		UpdateI = IRArena.create<UpdateInst>(Raw, Expressions);
 	}
-	IRPlusPlus[StoreI] = UpdateI;
+	IRPlusPlus.insert(UpdateI);
 	Expression* L = UpdateI->LHS;
 	printExp(L);
 	LLVM_DEBUG(dbgs() << " = ";);
 	Expression* R = UpdateI->RHS;
-	if (R -> symbol != newObj && R->RHSisAddress && L->RHSisAddress && (R->type != L->type) && L -> symbol != pointer) {
+	if (R->symbol == address) {
 		LLVM_DEBUG(dbgs() << " & ";);
-		R->symbol = address;
 	}
 	printExp(R);
 	LLVM_DEBUG(dbgs() << "\n";);
 }
 
-void LLVMIRPlusPlusPass::printExp(Expression* L) {
+void IRPlusPlusInfo::printExp(Expression* L) {
 	// prints the expression
 	if (L -> symbol == newObj){
         LLVM_DEBUG(dbgs() << " new ";);
@@ -527,60 +1228,31 @@ void Node::resetNode() {
 	RHS = nullptr;
 	abstractedInto = ir;
 	loc = -1;
+	callType = direct;
+	Func = nullptr;
+	Callee = nullptr;
+	Id = NoId;
 }
 
-NodeList Node::getSucc() {
+const NodeList& Node::getSucc() const {
 	// Returns the successors from the abstracted CFG
 	// If the successor of any node is not abstracted
-	// it goes a level up until it finds a node which
-	// is abstracted
-	NodeList ans;
-	NodeList WorkList;
-	WorkList = getRealSucc();
-	while (!WorkList.empty()) {
-		Node* temp = WorkList.back();
-		WorkList.pop_back();
-		if (temp->abstractedInto != ir) {
-			ans.push_back(temp);
-		} else {
-			std::vector<Node*> s = temp->getRealSucc();
-			for (Node* n : s) {
-				WorkList.push_back(n);
-			}
-		}
-	}
-	return ans;
+	// the edge goes through it until it finds a node which
+	// is abstracted, see CFG::abstractEdges
+	return AbsSucc;
 }
 
-NodeList Node::getPred() {
+const NodeList& Node::getPred() const {
 	// Returns the predecessors from the abstracted CFG
-	// If the predecessor of any node is not abstracted
-	// it goes a level down until it finds a node which
-	// is abstracted
-	NodeList ans;
-	NodeList WorkList;
-	WorkList = getRealPred();
-	while (!WorkList.empty()) {
-		Node* temp = WorkList.back();
-		WorkList.pop_back();
-		if (temp->abstractedInto != ir) {
-			ans.push_back(temp);
-		} else {
-			std::vector<Node*> p = temp->getRealPred();
-			for (Node* n : p) {
-				WorkList.push_back(n);
-			}
-		}
-	}
-	return ans;
+	return AbsPred;
 }
 
-NodeList Node::getRealSucc() {
+const NodeList& Node::getRealSucc() const {
 	// returns both abstracted and unabstracted successor nodes
 	return Succ;
 }
 
-NodeList Node::getRealPred() {
+const NodeList& Node::getRealPred() const {
 	// returns both abstracted and unabstracted predecessor nodes
 	return Pred;
 }
@@ -597,19 +1269,12 @@ void Node::print(){
 
 Node::Node() { resetNode(); }
 
-Node::Node(Instruction* I, InstMetaMap IRPlusPlus) {
+Node::Node(Instruction* I, const MetaDataStore& IRPlusPlus) {
 	LLVM_DEBUG(
 	    dbgs() << " ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ \n";);
 	resetNode();
 	if (I) {
 		LLVM_DEBUG(dbgs() << "Working on instruction " << *I << " \n";);
-		BasicBlock* parent = I->getParent();
-		Instruction* BBStartInst = &(parent->front());
-		LLVM_DEBUG(dbgs() << "BasicBlock starts with " << *BBStartInst
-				  << " \n";);
-		Instruction* BBEndInst = &(parent->back());
-		LLVM_DEBUG(dbgs() << "BasicBlock ends with " << *BBEndInst
-				  << " \n";);
 		Inst = I;
 		// Stores are abstracted
 		if (isa<StoreInst>(I)) {
@@ -621,12 +1286,9 @@ Node::Node(Instruction* I, InstMetaMap IRPlusPlus) {
 		if (abstractedInto == update) {
 			LLVM_DEBUG(dbgs() << "update node detected \n";);
 			StoreInst* storeInst = dyn_cast<StoreInst>(I);
-			if (storeInst) {
-				if (IRPlusPlus.find(storeInst) !=
-				    IRPlusPlus.end()) {
-					LHS = IRPlusPlus[storeInst]->LHS;
-					RHS = IRPlusPlus[storeInst]->RHS;
-				}
+			if (UpdateInst* UpdateI = IRPlusPlus.lookup(storeInst)) {
+				LHS = UpdateI->LHS;
+				RHS = UpdateI->RHS;
 			}
 		} else if (abstractedInto == call) {
 			LLVM_DEBUG(dbgs() << "call node detected \n";);
@@ -641,147 +1303,308 @@ Node::Node(Instruction* I, InstMetaMap IRPlusPlus) {
 					callType = direct;
 					Func = calledFunction;
 				}
+			} else if (isVirtualCall(tempCall)) {
+				LLVM_DEBUG(dbgs() << "It is a Virtual \n";);
+				callType = virt;
+				Callee = IRPlusPlus.lookupReceiver(tempCall);
 			} else {
-				// CallSite cs(tempCall);
-				Value* virtFunc = tempCall -> getCalledOperand();
-				if (LoadInst* virtFuncLoadInst = dyn_cast<LoadInst>(virtFunc)) {
-					Value* virtFuncPtr = virtFuncLoadInst -> getPointerOperand();
-					if (GetElementPtrInst* virtFuncPtrGEPInst = dyn_cast<GetElementPtrInst>(virtFuncPtr)) {
-						if (virtFuncPtrGEPInst ->getNumIndices() == 1) {
-							Value* virtTable = virtFuncPtrGEPInst ->getPointerOperand();
-							if (isa<LoadInst>(virtTable)) {
-								callType = virt;
-							}
-						}
-					}
-				}
-				if (callType == virt) {
-					LLVM_DEBUG(dbgs() << "It is a Virtual \n";);
-					Value* callValue = I->getOperand(0);
-					LoadInst* inst =
-					    dyn_cast<LoadInst>(callValue);
-					Callee = new RHSExpression(
-					    inst->getPointerOperand());
-                    Callee -> base = resolveBase(Callee -> base);
-                    
-				}
-			}
-		}
-		if (I == BBEndInst) {
-			// The instruction is the last instruction of the basic
-			// block It's successor would be the first instruction
-			// of all it's successor basic block
-			LLVM_DEBUG(
-			    dbgs() << "Instruction is the end instruction \n";);
-			for (BasicBlock* S : successors(parent)) {
-				Node* tempNode =
-				    new Node(&(S->front()), IRPlusPlus);
-				(tempNode->Pred).push_back(this);
-				Succ.push_back(tempNode);
-			}
-		} else if (I == BBStartInst) {
-			// The instruction is the start instruction of the basic
-			// block It's predecessors would be the last
-			// instructions of the predecessor basic block
-			LLVM_DEBUG(
-			    dbgs()
-				<< "Instruction is the start instruction \n";);
-			Instruction* SuccInstruction = nullptr;
-			SuccInstruction = I->getNextNonDebugInstruction();
-			if (SuccInstruction &&
-			    SuccInstruction->getParent() == parent) {
-				Node* tempNode =
-				    new Node(SuccInstruction, IRPlusPlus);
-				if(I -> getParent() -> hasNPredecessors(0) == false)
-                    (tempNode->Pred).push_back(tempNode);
-				Succ.push_back(tempNode);
-			}
-		} else {
-			LLVM_DEBUG(dbgs()
-				       << "Instruction is in middle of BB \n";);
-			Instruction* SuccInstruction = nullptr;
-			SuccInstruction = I->getNextNonDebugInstruction();
-			if (SuccInstruction &&
-			    SuccInstruction->getParent() == parent) {
-				Node* tempNode =
-				    new Node(SuccInstruction, IRPlusPlus);
-				(tempNode->Pred).push_back(this);
-				Succ.push_back(tempNode);
+				// Calls through a pointer are indirect
+				callType = indirect;
 			}
 		}
 	}
 }
 
+/* addEdge
+ * Connects From -> To in the unabstracted CFG
+ */
+static void addEdge(Node* From, Node* To) {
+	From->Succ.push_back(To);
+	To->Pred.push_back(From);
+}
+
 CFG::CFG() {
 	StartNode = nullptr;
 	EndNode = nullptr;
 }
 
-void CFG::init(Function* F, InstMetaMap IRPlusPlus) {
+void CFG::clear() {
+	StartNode = nullptr;
+	EndNode = nullptr;
+	NodeMap.clear();
+	Nodes.clear();
+	AbsNodes.clear();
+	Compact.reset();
+	NodeAllocator.DestroyAll();
+}
+
+void CFG::init(Function* F, const MetaDataStore& IRPlusPlus) {
 	// Check if the cfg already exist
 	if (StartNode) {
 		// The cgf is already inited
 		return;
 	}
-	// Iterate over functions
+	TimeTraceScope InitScope("CFG::init");
+	// Create exactly one node for every instruction, debug intrinsics
+	// are not part of the cfg
 	for (BasicBlock& BB : *F) {
-		// Iterate over basicblocks
-		for (Instruction& I : BB) {
-			// create a temp node for the first
-			// instruction, this will be the unique
-			// entry node
-			Node* tempNode = new Node(&I, IRPlusPlus);
-			// If no entry node is present make this
-			// an entry node
-			if (!StartNode) {
-				// No entry node present
-				StartNode = tempNode;
+		for (Instruction& I : BB.instructionsWithoutDebug()) {
+			Node* tempNode = new (NodeAllocator.Allocate())
+			    Node(&I, IRPlusPlus);
+			NodeMap[&I] = tempNode;
+			Nodes.push_back(tempNode);
+		}
+	}
+	// Declarations do not have a body and hence no cfg
+	if (Nodes.empty()) {
+		return;
+	}
+	// The first instruction of the entry block is the unique entry node
+	StartNode = Nodes.front();
+	// Wire the edges in a single pass over the basicblocks
+	for (BasicBlock& BB : *F) {
+		// Instructions inside a basicblock follow each other
+		Node* Prev = nullptr;
+		for (Instruction& I : BB.instructionsWithoutDebug()) {
+			Node* Curr = NodeMap[&I];
+			if (Prev) {
+				addEdge(Prev, Curr);
 			}
-			// There can be multiple leaves in the
-			// tree which are stored in EndInstList
-			NodeList EndInstList;
-			// Traverse over all the nodes until the
-			// worklist is empty
-			NodeList WorkList;
-			WorkList.push_back(StartNode);
-			while (!WorkList.empty()) {
-				// Take a node from worklist
-				Node* temp = WorkList.back();
-				// Remove it from worklist
-				WorkList.pop_back();
-				// If it is an leave node put it into
-				// EndInstList
-				if ((temp->getRealSucc()).size() == 0) {
-					// temp is a leaf node
-					EndInstList.push_back(temp);
-				}
-				// Insert successors of present node in
-				// the worklist
-				for (Node* s : temp->getRealSucc()) {
-					WorkList.push_back(s);
-				}
+			Prev = Curr;
+		}
+		// The last instruction of the basicblock is followed by the
+		// first instruction of all its successor basicblocks. A switch
+		// can name the same successor more than once, add the edge
+		// only once.
+		SmallPtrSet<BasicBlock*, 8> Visited;
+		for (BasicBlock* S : successors(&BB)) {
+			if (!Visited.insert(S).second) {
+				continue;
+			}
+			addEdge(Prev, getNode(&*S->instructionsWithoutDebug().begin()));
+		}
+	}
+	// endNode is the exit node
+	// It is the pseudo node and is the only node with
+	// Instruction field null
+	EndNode = new (NodeAllocator.Allocate()) Node;
+	for (Node* end : Nodes) {
+		// Make edge between return nodes and end nodes
+		// 	R1	R2	R3
+		//	\\	||     //
+		// 	 \\	||    //
+		// 	  \\||   //
+		// 	   endNode
+		if (end->Succ.empty()) {
+			addEdge(end, EndNode);
+		}
+	}
+	Nodes.push_back(EndNode);
+	TimeTraceScope EdgeScope("CFG::abstractEdges");
+	abstractEdges();
+}
+
+/* isAbstracted
+ * The abstracted cfg is made of the update and call nodes, the entry and
+ * the pseudo exit node are kept so that every path has a unique start and end
+ */
+bool CFG::isAbstracted(const Node* N) const {
+	return N->abstractedInto != ir || N == StartNode || N == EndNode;
+}
+
+/* abstractEdges
+ * Computes the edges of the abstracted cfg once. From every abstracted node
+ * the unabstracted (ir) nodes are walked until an abstracted node is found,
+ * each ir node is visited at most once per source so cycles of ir nodes
+ * terminate and every edge is added only once. Predecessors are the
+ * reversed successor edges.
+ * Unabstracted nodes other than the entry and exit have no abstracted edges.
+ */
+void CFG::abstractEdges() {
+	// Number the abstracted nodes densely in the order of the instructions
+	for (Node* N : Nodes) {
+		if (isAbstracted(N)) {
+			N->Id = AbsNodes.size();
+			AbsNodes.push_back(N);
+		}
+	}
+	for (Node* Source : AbsNodes) {
+		SmallPtrSet<Node*, 16> Visited;
+		NodeList WorkList(Source->Succ.begin(), Source->Succ.end());
+		while (!WorkList.empty()) {
+			Node* temp = WorkList.back();
+			WorkList.pop_back();
+			if (!Visited.insert(temp).second) {
+				continue;
+			}
+			if (isAbstracted(temp)) {
+				Source->AbsSucc.push_back(temp);
+				continue;
 			}
-			// endNode is the exit node
-			// It is the pseudo node and is the only node with
-			// Instruction field null
-			Node* endNode = new Node;
-			for (Node* end : WorkList) {
-				// Make edge between return nodes and end nodes
-				// 	R1	R2	R3
-				//	\\	||     //
-				// 	 \\	||    //
-				// 	  \\||   //
-				// 	   endNode
-				(end->getRealSucc()).push_back(endNode);
-				(endNode->getRealPred()).push_back(end);
+			for (Node* n : temp->Succ) {
+				WorkList.push_back(n);
 			}
+		}
+	}
+	for (Node* Source : AbsNodes) {
+		for (Node* Target : Source->AbsSucc) {
+			Target->AbsPred.push_back(Source);
+		}
+	}
+}
+
+/* restore
+ * Same nodes as init, the edges are taken from the shape instead of the
+ * basicblocks and abstractEdges is skipped. The shape is checked against the
+ * function before anything is allocated.
+ */
+bool CFG::restore(Function* F, const MetaDataStore& IRPlusPlus,
+		  const CFGShape& Shape) {
+	if (StartNode) {
+		return true;
+	}
+	TimeTraceScope Scope("CFG::restore");
+	size_t NumInsts = 0;
+	for (BasicBlock& BB : *F) {
+		NumInsts += std::distance(BB.instructionsWithoutDebug().begin(),
+					  BB.instructionsWithoutDebug().end());
+	}
+	size_t NumNodes = NumInsts + 1;
+	auto ValidCSR = [](const std::vector<uint32_t>& Offsets,
+			   const std::vector<uint32_t>& Edges, size_t N,
+			   size_t Bound) {
+		if (Offsets.size() != N + 1 || Offsets.front() != 0 ||
+		    Offsets.back() != Edges.size()) {
+			return false;
+		}
+		for (size_t I = 0; I < N; I++) {
+			if (Offsets[I] > Offsets[I + 1]) {
+				return false;
+			}
+		}
+		return all_of(Edges, [&](uint32_t E) { return E < Bound; });
+	};
+	// A cfg has at least the entry and the exit node
+	size_t NumAbs = Shape.AbsNodes.size();
+	if (NumInsts == 0 || NumAbs == 0 ||
+	    !ValidCSR(Shape.SuccOffsets, Shape.Succs, NumNodes, NumNodes) ||
+	    !ValidCSR(Shape.AbsSuccOffsets, Shape.AbsSuccs, NumAbs, NumAbs)) {
+		return false;
+	}
+	for (BasicBlock& BB : *F) {
+		for (Instruction& I : BB.instructionsWithoutDebug()) {
+			Node* tempNode = new (NodeAllocator.Allocate())
+			    Node(&I, IRPlusPlus);
+			NodeMap[&I] = tempNode;
+			Nodes.push_back(tempNode);
+		}
+	}
+	StartNode = Nodes.front();
+	EndNode = new (NodeAllocator.Allocate()) Node;
+	Nodes.push_back(EndNode);
+	for (size_t I = 0; I < NumNodes; I++) {
+		for (uint32_t E = Shape.SuccOffsets[I];
+		     E < Shape.SuccOffsets[I + 1]; E++) {
+			addEdge(Nodes[I], Nodes[Shape.Succs[E]]);
+		}
+	}
+	// The abstracted nodes depend on the metadata, a shape that disagrees
+	// with it is dropped
+	bool Matches = Shape.AbsNodes.back() == NumNodes - 1;
+	for (uint32_t N : Shape.AbsNodes) {
+		if (N >= NumNodes || !isAbstracted(Nodes[N]) ||
+		    Nodes[N]->Id != Node::NoId) {
+			Matches = false;
 			break;
 		}
+		Nodes[N]->Id = AbsNodes.size();
+		AbsNodes.push_back(Nodes[N]);
+	}
+	Matches &= count_if(Nodes, [&](Node* N) { return isAbstracted(N); }) ==
+		   (long)NumAbs;
+	if (!Matches) {
+		clear();
+		return false;
+	}
+	for (size_t I = 0; I < NumAbs; I++) {
+		for (uint32_t E = Shape.AbsSuccOffsets[I];
+		     E < Shape.AbsSuccOffsets[I + 1]; E++) {
+			AbsNodes[I]->AbsSucc.push_back(AbsNodes[Shape.AbsSuccs[E]]);
+		}
+	}
+	for (Node* Source : AbsNodes) {
+		for (Node* Target : Source->AbsSucc) {
+			Target->AbsPred.push_back(Source);
+		}
 	}
+	return true;
 }
 
-InstMetaMap LLVMIRPlusPlusPass::getIRPlusPlus() { return IRPlusPlus; }
-FunctionToCFG LLVMIRPlusPlusPass::getCFG() { return grcfg; }
+CFGShape CFG::getShape() const {
+	CFGShape Shape;
+	DenseMap<Node*, uint32_t> Index;
+	for (Node* N : Nodes) {
+		uint32_t Id = Index.size();
+		Index[N] = Id;
+	}
+	Shape.SuccOffsets.push_back(0);
+	for (Node* N : Nodes) {
+		for (Node* S : N->getRealSucc()) {
+			Shape.Succs.push_back(Index[S]);
+		}
+		Shape.SuccOffsets.push_back(Shape.Succs.size());
+	}
+	Shape.AbsSuccOffsets.push_back(0);
+	for (Node* N : AbsNodes) {
+		Shape.AbsNodes.push_back(Index[N]);
+		for (Node* S : N->getSucc()) {
+			Shape.AbsSuccs.push_back(S->Id);
+		}
+		Shape.AbsSuccOffsets.push_back(Shape.AbsSuccs.size());
+	}
+	return Shape;
+}
+
+const CompactCFG& CFG::getCompactCFG() {
+	if (!Compact) {
+		Compact.reset(new CompactCFG(*this));
+	}
+	return *Compact;
+}
+
+/* Constructor for CompactCFG
+ * Flattens the abstracted cfg into offset and edge arrays, edges keep the
+ * order of Node::getSucc and Node::getPred
+ */
+CompactCFG::CompactCFG(const CFG& G) {
+	const NodeList& AbsNodes = G.getAbstractedNodes();
+	size_t NumNodes = AbsNodes.size();
+	SuccOffsets.reserve(NumNodes + 1);
+	PredOffsets.reserve(NumNodes + 1);
+	Insts.reserve(NumNodes);
+	LHSs.reserve(NumNodes);
+	RHSs.reserve(NumNodes);
+	Kinds.reserve(NumNodes);
+	for (Node* N : AbsNodes) {
+		SuccOffsets.push_back(SuccEdges.size());
+		for (Node* S : N->getSucc()) {
+			SuccEdges.push_back(S->Id);
+		}
+		PredOffsets.push_back(PredEdges.size());
+		for (Node* P : N->getPred()) {
+			PredEdges.push_back(P->Id);
+		}
+		Insts.push_back(N->Inst);
+		LHSs.push_back(N->LHS);
+		RHSs.push_back(N->RHS);
+		Kinds.push_back(N->abstractedInto);
+	}
+	SuccOffsets.push_back(SuccEdges.size());
+	PredOffsets.push_back(PredEdges.size());
+}
+
+Node* CFG::getNode(Instruction* I) const { return NodeMap.lookup(I); }
+
 
  Instruction * resolveBase(Instruction * Inst){
     if(!Inst){
@@ -822,16 +1645,158 @@ bool compareGEP(GetElementPtrInst* I1, GetElementPtrInst * I2){
     return true;
 }
 
-Instruction *handleGEP(GetElementPtrInst* Inst){
-    for(GetElementPtrInst * I : GEPVec){
+unsigned hashGEP(GetElementPtrInst* I){
+    hash_code Hash = hash_value(I -> getSourceElementType());
+    for(Value * Idx : I -> indices()){
+        Hash = hash_combine(Hash, Idx);
+    }
+    return Hash;
+}
+
+Instruction *FieldIndex::handleGEP(GetElementPtrInst* Inst){
+    auto& Bucket = Buckets[hashGEP(Inst)];
+    // deleted GEPs are nulled by their handle
+    Bucket.erase(remove_if(Bucket, [](WeakVH& VH){ return !VH; }),
+                 Bucket.end());
+    for(WeakVH & VH : Bucket){
+        GetElementPtrInst * I = cast<GetElementPtrInst>(VH);
         if(compareGEP(I, Inst)){
+            if(I != Inst){
+                ++NumGEPsDeduplicated;
+            }
             return I;
         }
     }
-    GEPVec.push_back(Inst);
+    ++NumFieldPaths;
+    Bucket.push_back(WeakVH(Inst));
     return dyn_cast<Instruction>(Inst); 
 }
 
+void applyCommandLineOptions(IRPlusPlusInfo& Info) {
+	Info.setTrackChanges(TrackChanges);
+	if (!CacheDir.empty()) {
+		Info.setCache(std::make_shared<SummaryCache>(CacheDir));
+	}
+}
+
+unsigned getNumThreadsOption() { return Threads; }
+
+TimeTraceSession::TimeTraceSession() {
+	if (TimeTrace.empty() || timeTraceProfilerEnabled()) {
+		return;
+	}
+	timeTraceProfilerInitialize(TimeTraceGranularity, "llvmir++");
+	Owner = true;
+}
+
+TimeTraceSession::~TimeTraceSession() {
+	if (!Owner) {
+		return;
+	}
+	if (Error E = timeTraceProfilerWrite(TimeTrace, "")) {
+		logAllUnhandledErrors(std::move(E), errs(), TimeTrace + ": ");
+	}
+	timeTraceProfilerCleanup();
+}
+
+LLVMIRPlusPlusPass::LLVMIRPlusPlusPass() : ModulePass(ID) {}
+
+bool LLVMIRPlusPlusPass::runOnModule(Module& M) {
+	TimeTraceSession Trace;
+	TimeTraceScope Scope("LLVMIRPlusPlusPass", M.getModuleIdentifier());
+	Info.clear();
+	applyCommandLineOptions(Info);
+	// In lazy mode nothing is generated until it is queried
+	if (!Lazy) {
+		Info.analyze(M, Threads);
+	}
+	if (!EmitBinary.empty()) {
+		writeResults(M, Info, EmitBinary);
+	}
+	if (!EmitJSON.empty()) {
+		writeJSONLines(M, Info, EmitJSON);
+	}
+	return false;
+}
+
+void LLVMIRPlusPlusPass::getAnalysisUsage(AnalysisUsage& AU) const {
+	AU.setPreservesAll();
+}
+
+void LLVMIRPlusPlusPass::releaseMemory() { Info.clear(); }
+
+void LLVMIRPlusPlusPass::printExp(Expression* L) { Info.printExp(L); }
+
+const MetaDataStore& LLVMIRPlusPlusPass::getIRPlusPlus() {
+	return Info.getIRPlusPlus();
+}
+
+FunctionToCFG LLVMIRPlusPlusPass::getCFG() { return Info.getCFG(); }
+
+CFG* LLVMIRPlusPlusPass::getCFG(Function* F) { return Info.getCFG(F); }
+
+UpdateInst* LLVMIRPlusPlusPass::getMetaData(StoreInst* StoreI) {
+	return Info.getMetaData(StoreI);
+}
+
+void LLVMIRPlusPlusPass::generateMetaData(StoreInst* StoreI) {
+	Info.generateMetaData(StoreI);
+}
+
+AnalysisKey IRPlusPlusAnalysis::Key;
+
+IRPlusPlusAnalysis::Result IRPlusPlusAnalysis::run(Module& M,
+						   ModuleAnalysisManager&) {
+	TimeTraceSession Trace;
+	TimeTraceScope Scope("IRPlusPlusAnalysis", M.getModuleIdentifier());
+	std::unique_ptr<IRPlusPlusInfo> Info(new IRPlusPlusInfo());
+	applyCommandLineOptions(*Info);
+	if (!Lazy) {
+		Info->analyze(M, Threads);
+	}
+	if (!EmitBinary.empty()) {
+		writeResults(M, *Info, EmitBinary);
+	}
+	if (!EmitJSON.empty()) {
+		writeJSONLines(M, *Info, EmitJSON);
+	}
+	return Result(std::move(Info));
+}
+
+/* invalidate
+ * The metadata and cfgs point into the IR, they stay valid only if the pass
+ * preserved this analysis or all the module analyses
+ */
+bool IRPlusPlusAnalysis::Result::invalidate(
+    Module&, const PreservedAnalyses& PA,
+    ModuleAnalysisManager::Invalidator&) {
+	auto PAC = PA.getChecker<IRPlusPlusAnalysis>();
+	return !(PAC.preserved() ||
+		 PAC.preservedSet<AllAnalysesOn<Module>>());
+}
+
+AnalysisKey IRPlusPlusFunctionAnalysis::Key;
+
+IRPlusPlusFunctionAnalysis::Result IRPlusPlusFunctionAnalysis::run(
+    Function& F, FunctionAnalysisManager&) {
+	// Every function writes the trace again, opt -time-trace keeps the
+	// spans of all of them
+	TimeTraceSession Trace;
+	TimeTraceScope Scope("IRPlusPlusFunctionAnalysis", F.getName());
+	std::unique_ptr<IRPlusPlusInfo> Info(new IRPlusPlusInfo());
+	applyCommandLineOptions(*Info);
+	Info->analyze(F);
+	return Result(std::move(Info), &F);
+}
+
+bool IRPlusPlusFunctionAnalysis::Result::invalidate(
+    Function&, const PreservedAnalyses& PA,
+    FunctionAnalysisManager::Invalidator&) {
+	auto PAC = PA.getChecker<IRPlusPlusFunctionAnalysis>();
+	return !(PAC.preserved() ||
+		 PAC.preservedSet<AllAnalysesOn<Function>>());
+}
+
 char LLVMIRPlusPlusPass::ID = 0;
 static RegisterPass<LLVMIRPlusPlusPass> X(
     "llvmir++",					     // the option name
@@ -839,3 +1804,72 @@ static RegisterPass<LLVMIRPlusPlusPass> X(
     true,  // true as we don't modify the CFG
     true   // true if we're writing an analysis
 );
+
+/* llvmGetPassPluginInfo
+ * Registers the analyses with the new pass manager. -passes=llvmir++ computes
+ * the module analysis and -passes='function(llvmir++)' the function analysis,
+ * later passes of the pipeline get the cached results from the analysis
+ * managers. The print<llvmir++-*> passes print the analyses built on top of
+ * the module analysis.
+ */
+extern "C" LLVM_ATTRIBUTE_WEAK PassPluginLibraryInfo llvmGetPassPluginInfo() {
+	return {LLVM_PLUGIN_API_VERSION, "LLVMIRPlusPlus", "v0.1",
+		[](PassBuilder& PB) {
+			PB.registerAnalysisRegistrationCallback(
+			    [](ModuleAnalysisManager& MAM) {
+				    MAM.registerPass(
+					[] { return IRPlusPlusAnalysis(); });
+			    });
+			PB.registerAnalysisRegistrationCallback(
+			    [](FunctionAnalysisManager& FAM) {
+				    FAM.registerPass([] {
+					    return IRPlusPlusFunctionAnalysis();
+				    });
+			    });
+			PB.registerPipelineParsingCallback(
+			    [](StringRef Name, ModulePassManager& MPM,
+			       ArrayRef<PassBuilder::PipelineElement>) {
+				    if (Name != "llvmir++") {
+					    return false;
+				    }
+				    MPM.addPass(RequireAnalysisPass<
+						IRPlusPlusAnalysis, Module>());
+				    return true;
+			    });
+			PB.registerPipelineParsingCallback(
+			    [](StringRef Name, ModulePassManager& MPM,
+			       ArrayRef<PassBuilder::PipelineElement>) {
+				    if (Name == "print<llvmir++-dataflow>") {
+					    MPM.addPass(
+						DataFlowPrinterPass(errs()));
+					    return true;
+				    }
+				    if (Name == "print<llvmir++-andersen>") {
+					    MPM.addPass(
+						AndersenPrinterPass(errs()));
+					    return true;
+				    }
+				    if (Name == "print<llvmir++-steensgaard>") {
+					    MPM.addPass(
+						SteensgaardPrinterPass(errs()));
+					    return true;
+				    }
+				    if (Name == "print<llvmir++-vfcr>") {
+					    MPM.addPass(VFCRPrinterPass(errs()));
+					    return true;
+				    }
+				    return false;
+			    });
+			PB.registerPipelineParsingCallback(
+			    [](StringRef Name, FunctionPassManager& FPM,
+			       ArrayRef<PassBuilder::PipelineElement>) {
+				    if (Name != "llvmir++") {
+					    return false;
+				    }
+				    FPM.addPass(RequireAnalysisPass<
+						IRPlusPlusFunctionAnalysis,
+						Function>());
+				    return true;
+			    });
+		}};
+}
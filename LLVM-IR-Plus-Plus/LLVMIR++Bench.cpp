@@ -0,0 +1,483 @@
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include "include/LLVMIR++.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/WithColor.h"
+
+using namespace llvm;
+
+/* llvmir++-bench
+ * Generates a module of synthetic functions shaped like the worst cases the
+ * analysis meets, deep GEP chains, wide switches, nested loops, long virtual
+ * call chains and long runs of stores, and measures resolveBase, handleGEP,
+ * generateMetaData and CFG::init on it one phase at a time. With -doublings
+ * the module is generated again at twice the size, the growth of every phase
+ * from one size to the next shows super-linear behaviour.
+ */
+
+static cl::opt<unsigned> NumFunctions("functions",
+				      cl::desc("Number of generated functions"),
+				      cl::init(1000));
+
+static cl::opt<unsigned> GEPDepth(
+    "gep-depth", cl::desc("Nesting depth of the structs accessed by GEPs"),
+    cl::init(8));
+
+static cl::opt<unsigned> SwitchWidth("switch-width",
+				     cl::desc("Number of cases of a switch"),
+				     cl::init(64));
+
+static cl::opt<unsigned> LoopDepth("loop-depth",
+				   cl::desc("Nesting depth of the loops"),
+				   cl::init(4));
+
+static cl::opt<unsigned> VirtualChain(
+    "virtual-chain",
+    cl::desc("Length of the chain of virtual functions calling each other"),
+    cl::init(30));
+
+static cl::opt<unsigned> NumStores(
+    "stores", cl::desc("Number of straight line stores of a function"),
+    cl::init(64));
+
+static cl::opt<unsigned> Doublings(
+    "doublings",
+    cl::desc("Number of times the benchmark is repeated with twice the "
+	     "functions"),
+    cl::init(0));
+
+static cl::opt<double> MaxGrowth(
+    "max-growth",
+    cl::desc("Fail if the time of a phase grows more than this factor when "
+	     "the functions double (0 does not check)"),
+    cl::init(0));
+
+static cl::opt<std::string> EmitModule(
+    "emit", cl::desc("Write the generated module of the first size"),
+    cl::value_desc("file"), cl::init(""));
+
+/* ModuleGenerator
+ * Builds the synthetic module. The generated IR looks like clang -O0 output,
+ * locals live in allocas and every access goes through loads and stores.
+ */
+class ModuleGenerator {
+	Module& M;
+	LLVMContext& Context;
+	IRBuilder<> Builder;
+	Type* Int32;
+	// Deep[K] is { i32, Deep[K - 1] }, Deep[0] is { i32, i32* }
+	std::vector<StructType*> Deep;
+	// Class of the virtual chain, its only field is the vtable pointer
+	StructType* Class;
+	FunctionType* VirtualType;
+	std::vector<Constant*> Virtuals;
+
+	void createVirtualChain();
+	void generateGEPChains(Function*);
+	void generateSwitch(Function*);
+	void generateLoops(Function*);
+	void generateStores(Function*);
+	void generateVirtualCall();
+
+       public:
+	ModuleGenerator(Module& M)
+	    : M(M), Context(M.getContext()), Builder(Context),
+	      Int32(Type::getInt32Ty(Context)) {}
+	void generate(unsigned Functions);
+};
+
+void ModuleGenerator::generate(unsigned Functions) {
+	StructType* Inner =
+	    StructType::create({Int32, Int32->getPointerTo()}, "struct.Deep0");
+	Deep.push_back(Inner);
+	for (unsigned K = 1; K <= GEPDepth; K++) {
+		Deep.push_back(StructType::create(
+		    {Int32, Deep.back()}, "struct.Deep" + std::to_string(K)));
+	}
+	createVirtualChain();
+	FunctionType* FTy = FunctionType::get(Int32, {Int32}, false);
+	for (unsigned I = 0; I < Functions; I++) {
+		Function* F =
+		    Function::Create(FTy, GlobalValue::ExternalLinkage,
+				     "bench" + std::to_string(I), M);
+		Builder.SetInsertPoint(BasicBlock::Create(Context, "entry", F));
+		// Every function has all the shapes, one after the other
+		generateStores(F);
+		generateGEPChains(F);
+		generateVirtualCall();
+		generateLoops(F);
+		generateSwitch(F);
+		Builder.CreateRet(ConstantInt::get(Int32, I));
+	}
+}
+
+/* createVirtualChain
+ * Like infi-virtual-call.cpp, virtual function K calls virtual function
+ * K - 1 through the vtable of this
+ */
+void ModuleGenerator::createVirtualChain() {
+	Class = StructType::create(Context, "class.Chain");
+	VirtualType =
+	    FunctionType::get(Int32, {Class->getPointerTo()}, false);
+	Type* Slot = VirtualType->getPointerTo();
+	Class->setBody({Slot->getPointerTo()});
+	for (unsigned K = 0; K < std::max(1u, unsigned(VirtualChain)); K++) {
+		Function* F = Function::Create(VirtualType,
+					       GlobalValue::ExternalLinkage,
+					       "Chain.foo" + std::to_string(K), M);
+		Builder.SetInsertPoint(BasicBlock::Create(Context, "entry", F));
+		if (K == 0) {
+			Builder.CreateRet(ConstantInt::get(Int32, 42));
+		} else {
+			AllocaInst* ThisAddr =
+			    Builder.CreateAlloca(Class->getPointerTo());
+			Builder.CreateStore(F->getArg(0), ThisAddr);
+			Value* This = Builder.CreateLoad(Class->getPointerTo(),
+							 ThisAddr);
+			Value* VTablePtr = Builder.CreateBitCast(
+			    This, Slot->getPointerTo()->getPointerTo());
+			Value* VTable =
+			    Builder.CreateLoad(Slot->getPointerTo(), VTablePtr);
+			Value* VFn = Builder.CreateGEP(Slot, VTable,
+						       Builder.getInt64(K - 1));
+			Value* Callee = Builder.CreateLoad(Slot, VFn);
+			Builder.CreateRet(
+			    Builder.CreateCall(VirtualType, Callee, {This}));
+		}
+		Virtuals.push_back(F);
+	}
+	GlobalVariable* VTable = new GlobalVariable(
+	    M, ArrayType::get(Slot, Virtuals.size()), true,
+	    GlobalValue::ExternalLinkage,
+	    ConstantArray::get(ArrayType::get(Slot, Virtuals.size()), Virtuals),
+	    "vtable.Chain");
+	(void)VTable;
+}
+
+/* generateStores
+ * Straight line copies, address takings and stores through pointers between
+ * a few locals
+ */
+void ModuleGenerator::generateStores(Function* F) {
+	AllocaInst* X = Builder.CreateAlloca(Int32, nullptr, "x");
+	AllocaInst* Y = Builder.CreateAlloca(Int32, nullptr, "y");
+	AllocaInst* P = Builder.CreateAlloca(Int32->getPointerTo(), nullptr,
+					     "p");
+	AllocaInst* Q = Builder.CreateAlloca(Int32->getPointerTo(), nullptr,
+					     "q");
+	Builder.CreateStore(F->getArg(0), X);
+	for (unsigned I = 0; I < NumStores; I++) {
+		switch (I % 4) {
+		case 0:
+			// y = x
+			Builder.CreateStore(Builder.CreateLoad(Int32, X), Y);
+			break;
+		case 1:
+			// p = &x
+			Builder.CreateStore(I % 8 == 1 ? X : Y, P);
+			break;
+		case 2:
+			// *p = y
+			Builder.CreateStore(
+			    Builder.CreateLoad(Int32, Y),
+			    Builder.CreateLoad(Int32->getPointerTo(), P));
+			break;
+		case 3:
+			// q = p
+			Builder.CreateStore(
+			    Builder.CreateLoad(Int32->getPointerTo(), P), Q);
+			break;
+		}
+	}
+}
+
+/* generateGEPChains
+ * Stores into the innermost field of the deepest struct, every level is a
+ * GEP of its own. The chain is built twice so that every field path has a
+ * duplicate for handleGEP to fold.
+ */
+void ModuleGenerator::generateGEPChains(Function* F) {
+	AllocaInst* Object = Builder.CreateAlloca(Deep.back(), nullptr, "obj");
+	AllocaInst* Ptr = Builder.CreateAlloca(Deep.back()->getPointerTo(),
+					       nullptr, "ptr");
+	Builder.CreateStore(Object, Ptr);
+	for (unsigned Copy = 0; Copy < 2; Copy++) {
+		Value* Base = Builder.CreateLoad(Deep.back()->getPointerTo(), Ptr);
+		for (unsigned K = Deep.size() - 1; K > 0; K--) {
+			// Every level stores into its scalar field
+			Builder.CreateStore(
+			    F->getArg(0), Builder.CreateStructGEP(Deep[K], Base, 0));
+			Base = Builder.CreateStructGEP(Deep[K], Base, 1);
+		}
+		Builder.CreateStore(Builder.CreateStructGEP(Deep[0], Base, 0),
+				    Builder.CreateStructGEP(Deep[0], Base, 1));
+	}
+}
+
+// Calls the last virtual function of the chain through the vtable
+void ModuleGenerator::generateVirtualCall() {
+	Type* Slot = VirtualType->getPointerTo();
+	AllocaInst* Object = Builder.CreateAlloca(Class, nullptr, "chain");
+	AllocaInst* Ptr =
+	    Builder.CreateAlloca(Class->getPointerTo(), nullptr, "chainptr");
+	Builder.CreateStore(Object, Ptr);
+	Value* This = Builder.CreateLoad(Class->getPointerTo(), Ptr);
+	Value* VTable = Builder.CreateLoad(
+	    Slot->getPointerTo(),
+	    Builder.CreateBitCast(This, Slot->getPointerTo()->getPointerTo()));
+	Value* VFn =
+	    Builder.CreateGEP(Slot, VTable, Builder.getInt64(Virtuals.size() - 1));
+	Builder.CreateCall(VirtualType, Builder.CreateLoad(Slot, VFn), {This});
+}
+
+/* generateLoops
+ * LoopDepth nested counted loops, the innermost one stores into a local
+ */
+void ModuleGenerator::generateLoops(Function* F) {
+	AllocaInst* Sum = Builder.CreateAlloca(Int32, nullptr, "sum");
+	Builder.CreateStore(Builder.getInt32(0), Sum);
+	std::vector<std::pair<BasicBlock*, AllocaInst*>> Headers;
+	for (unsigned D = 0; D < LoopDepth; D++) {
+		AllocaInst* Counter = Builder.CreateAlloca(Int32, nullptr, "i");
+		Builder.CreateStore(Builder.getInt32(0), Counter);
+		BasicBlock* Header = BasicBlock::Create(Context, "loop", F);
+		Builder.CreateBr(Header);
+		Builder.SetInsertPoint(Header);
+		Headers.emplace_back(Header, Counter);
+	}
+	Builder.CreateStore(
+	    Builder.CreateAdd(Builder.CreateLoad(Int32, Sum), F->getArg(0)),
+	    Sum);
+	for (auto It = Headers.rbegin(); It != Headers.rend(); ++It) {
+		AllocaInst* Counter = It->second;
+		Value* Next = Builder.CreateAdd(Builder.CreateLoad(Int32, Counter),
+						Builder.getInt32(1));
+		Builder.CreateStore(Next, Counter);
+		BasicBlock* Exit = BasicBlock::Create(Context, "exit", F);
+		Builder.CreateCondBr(
+		    Builder.CreateICmpSLT(Next, Builder.getInt32(8)), It->first,
+		    Exit);
+		Builder.SetInsertPoint(Exit);
+	}
+}
+
+/* generateSwitch
+ * A switch on the argument with SwitchWidth cases, every case stores into
+ * the same local and falls into the join block
+ */
+void ModuleGenerator::generateSwitch(Function* F) {
+	AllocaInst* Result = Builder.CreateAlloca(Int32, nullptr, "result");
+	BasicBlock* Join = BasicBlock::Create(Context, "join", F);
+	SwitchInst* Switch =
+	    Builder.CreateSwitch(F->getArg(0), Join, SwitchWidth);
+	for (unsigned I = 0; I < SwitchWidth; I++) {
+		BasicBlock* Case = BasicBlock::Create(Context, "case", F, Join);
+		Switch->addCase(Builder.getInt32(I), Case);
+		Builder.SetInsertPoint(Case);
+		Builder.CreateStore(Builder.getInt32(I), Result);
+		Builder.CreateBr(Join);
+	}
+	Builder.SetInsertPoint(Join);
+}
+
+/* PhaseResult
+ * Wall time, heap growth and peak resident memory of one phase
+ */
+struct PhaseResult {
+	StringRef Name;
+	double Seconds;
+	int64_t HeapBytes;
+	uint64_t PeakRSS;
+};
+
+/* ModuleCounts
+ * Size of the generated module and what the timed helpers found in it, a
+ * sanity check that they did their work
+ */
+struct ModuleCounts {
+	size_t Instructions = 0;
+	// Pointers resolveBase traced back to an instruction
+	size_t Resolved = 0;
+	// GEPs handleGEP kept as the canonical GEP of their field path
+	size_t FieldPaths = 0;
+};
+
+#ifdef __linux__
+// Resets the peak resident memory of the process, needs Linux 4.0
+static void resetPeakRSS() {
+	std::error_code EC;
+	raw_fd_ostream OS("/proc/self/clear_refs", EC, sys::fs::OF_Append);
+	if (!EC) {
+		OS << "5";
+	}
+}
+
+// Peak resident memory in bytes since the last reset
+static uint64_t getPeakRSS() {
+	auto Status = MemoryBuffer::getFileAsStream("/proc/self/status");
+	if (!Status) {
+		return 0;
+	}
+	StringRef Text = (*Status)->getBuffer();
+	size_t Pos = Text.find("VmHWM:");
+	uint64_t KB = 0;
+	if (Pos != StringRef::npos) {
+		Text.drop_front(Pos + 6).ltrim().consumeInteger(10, KB);
+	}
+	return KB * 1024;
+}
+#else
+static void resetPeakRSS() {}
+static uint64_t getPeakRSS() { return 0; }
+#endif
+
+static PhaseResult measure(StringRef Name, function_ref<void()> Phase) {
+	resetPeakRSS();
+	size_t Heap = sys::Process::GetMallocUsage();
+	TimeRecord Time = TimeRecord::getCurrentTime(true);
+	Phase();
+	TimeRecord End = TimeRecord::getCurrentTime(false);
+	End -= Time;
+	return {Name, End.getWallTime(),
+		int64_t(sys::Process::GetMallocUsage()) - int64_t(Heap),
+		getPeakRSS()};
+}
+
+/* runBenchmark
+ * Measures the phases in the order of the analysis. resolveBase and
+ * handleGEP are timed on their own over every instruction they apply to,
+ * generateMetaData includes the interning of the expressions.
+ */
+static std::vector<PhaseResult> runBenchmark(unsigned Functions,
+					     ModuleCounts& Counts) {
+	std::vector<PhaseResult> Results;
+	LLVMContext Context;
+	Module M("llvmir++-bench", Context);
+	Results.push_back(measure("generate", [&] {
+		ModuleGenerator(M).generate(Functions);
+	}));
+	if (verifyModule(M, &errs())) {
+		report_fatal_error("llvmir++-bench generated invalid IR");
+	}
+	if (!EmitModule.empty()) {
+		std::error_code EC;
+		ToolOutputFile Out(EmitModule, EC, sys::fs::OF_Text);
+		if (EC) {
+			WithColor::error() << EmitModule << ": " << EC.message()
+					   << "\n";
+		} else {
+			M.print(Out.os(), nullptr);
+			Out.keep();
+		}
+		EmitModule = "";
+	}
+	std::vector<Instruction*> Pointers;
+	std::vector<GetElementPtrInst*> GEPs;
+	std::vector<StoreInst*> Stores;
+	Counts = ModuleCounts();
+	for (Function& F : M) {
+		for (Instruction& I : instructions(F)) {
+			Counts.Instructions++;
+			if (auto* GEP = dyn_cast<GetElementPtrInst>(&I)) {
+				GEPs.push_back(GEP);
+			} else if (auto* SI = dyn_cast<StoreInst>(&I)) {
+				Stores.push_back(SI);
+			}
+			if (I.getType()->isPointerTy()) {
+				Pointers.push_back(&I);
+			}
+		}
+	}
+	Results.push_back(measure("resolveBase", [&] {
+		for (Instruction* I : Pointers) {
+			Counts.Resolved += resolveBase(I) != nullptr;
+		}
+	}));
+	Results.push_back(measure("handleGEP", [&] {
+		FieldIndex Fields;
+		for (GetElementPtrInst* GEP : GEPs) {
+			Counts.FieldPaths += Fields.handleGEP(GEP) == GEP;
+		}
+	}));
+	IRPlusPlusInfo Info;
+	Results.push_back(measure("generateMetaData", [&] {
+		for (StoreInst* SI : Stores) {
+			Info.generateMetaData(SI);
+		}
+	}));
+	{
+		std::vector<std::unique_ptr<CFG>> CFGs;
+		Results.push_back(measure("CFG::init", [&] {
+			for (Function& F : M) {
+				CFGs.emplace_back(new CFG);
+				CFGs.back()->init(&F, Info.getIRPlusPlus());
+			}
+		}));
+	}
+	Info.clear();
+	Results.push_back(measure("analyze", [&] {
+		Info.analyze(M, getNumThreadsOption());
+	}));
+	return Results;
+}
+
+int main(int argc, char** argv) {
+	InitLLVM X(argc, argv);
+	cl::ParseCommandLineOptions(argc, argv, "LLVM IR++ benchmark\n");
+
+	outs() << "phase               functions      seconds  us/function      "
+		  "heap MB      peak MB   growth\n";
+	std::vector<PhaseResult> Previous;
+	bool TooSlow = false;
+	for (unsigned D = 0; D <= Doublings; D++) {
+		unsigned Functions = NumFunctions << D;
+		ModuleCounts Counts;
+		std::vector<PhaseResult> Results =
+		    runBenchmark(Functions, Counts);
+		for (size_t I = 0; I < Results.size(); I++) {
+			const PhaseResult& R = Results[I];
+			double Growth = 0;
+			if (!Previous.empty() && Previous[I].Seconds > 0) {
+				Growth = R.Seconds / Previous[I].Seconds;
+			}
+			outs() << left_justify(R.Name, 18)
+			       << format(" %10u %12.4f %12.3f %12.2f %12.2f ",
+					 Functions, R.Seconds,
+					 R.Seconds * 1e6 / Functions,
+					 R.HeapBytes / (1024.0 * 1024.0),
+					 R.PeakRSS / (1024.0 * 1024.0));
+			if (Previous.empty()) {
+				outs() << "       -\n";
+			} else {
+				outs() << format("%8.2f\n", Growth);
+			}
+			// The generator is not part of the analysis
+			if (MaxGrowth > 0 && Growth > MaxGrowth &&
+			    R.Name != "generate") {
+				TooSlow = true;
+			}
+		}
+		outs() << left_justify("module", 18)
+		       << format(" %10u %12zu instructions, %zu resolved "
+				 "bases, %zu field paths\n",
+				 Functions, Counts.Instructions,
+				 Counts.Resolved, Counts.FieldPaths);
+		Previous = std::move(Results);
+	}
+	if (TooSlow) {
+		WithColor::error() << "a phase grew faster than -max-growth\n";
+		return 1;
+	}
+	return 0;
+}
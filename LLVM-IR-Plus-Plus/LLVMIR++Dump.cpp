@@ -0,0 +1,105 @@
+#include <cstdio>
+#include "include/ResultFormat.h"
+
+using namespace irpp;
+
+/* llvmir++-dump
+ * Prints a binary result file as text, function by function: its statements
+ * and then the nodes of its abstracted cfg with their edges. It only uses
+ * ResultFormat.h and does not link LLVM, a file the reader rejects is
+ * reported and nothing is printed.
+ */
+
+static const char* const SymbolNames[] = {
+    "simple", "pointer", "arrow", "dot", "constant", "address", "newObj"};
+static const char* const NodeKindNames[] = {"ir", "update", "call"};
+static const char* const CallKindNames[] = {"direct", "indirect", "virtual",
+					    "intrinsic"};
+
+class Dumper {
+	const ResultReader& R;
+	// Index of the function being printed
+	uint32_t Function = NoIndex;
+
+	// Values of another function are qualified with its name
+	void printValue(uint32_t V) {
+		if (V == NoIndex) {
+			printf("-");
+			return;
+		}
+		const ValueRecord& Record = R.getValues()[V];
+		printf("%s", R.getString(Record.Name));
+		if (Record.Function != NoIndex && Record.Function != Function) {
+			printf(" (in %s)",
+			       R.getString(R.getFunctions()[Record.Function].Name));
+		}
+	}
+	void printExpression(uint32_t E) {
+		if (E == NoIndex) {
+			printf("-");
+			return;
+		}
+		const ExpressionRecord& Record = R.getExpressions()[E];
+		printf("%s ", SymbolNames[Record.Symbol]);
+		printValue(Record.Base != NoIndex ? Record.Base
+						  : Record.FunctionArg);
+		if (Record.Optional != NoIndex) {
+			printf(" ");
+			printValue(Record.Optional);
+		}
+	}
+	void printEdges(const char* Label, ArrayView<uint32_t> Edges) {
+		printf(" %s", Label);
+		for (uint32_t N : Edges) {
+			printf(" %u", N);
+		}
+	}
+
+       public:
+	explicit Dumper(const ResultReader& R) : R(R) {}
+	void dump() {
+		for (Function = 0; Function < R.getFunctions().size(); Function++) {
+			const FunctionRecord& F = R.getFunctions()[Function];
+			printf("function %s\n", R.getString(F.Name));
+			for (const StatementRecord& S : R.getStatements(F)) {
+				printf("  statement ");
+				printValue(S.Inst);
+				if (S.Node != NoIndex) {
+					printf(" node %u", S.Node);
+				}
+				printf(": ");
+				printExpression(S.LHS);
+				printf(" = ");
+				printExpression(S.RHS);
+				printf("\n");
+			}
+			for (uint32_t N = 0; N < F.NumNodes; N++) {
+				const NodeRecord& Node = R.getNodes(F)[N];
+				printf("  node %u %s ", N, NodeKindNames[Node.Kind]);
+				printValue(Node.Inst);
+				if (Node.Kind == CallNode) {
+					printf(" %s ", CallKindNames[Node.Call]);
+					printValue(Node.Callee);
+				}
+				printf(":");
+				printEdges("succ", R.getSucc(F, N));
+				printEdges("pred", R.getPred(F, N));
+				printf("\n");
+			}
+		}
+	}
+};
+
+int main(int argc, char** argv) {
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s <result file>\n", argv[0]);
+		return 1;
+	}
+	MappedResultFile File;
+	if (!File.open(argv[1])) {
+		fprintf(stderr, "%s: not a valid result file\n", argv[1]);
+		return 1;
+	}
+	Dumper(File.getReader()).dump();
+	return 0;
+}
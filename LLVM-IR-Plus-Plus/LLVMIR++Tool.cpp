@@ -0,0 +1,375 @@
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include "include/LLVMIR++.h"
+#include "include/ResultWriter.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/IR/LLVMRemarkStreamer.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/WithColor.h"
+
+using namespace llvm;
+
+/* llvmir++-tool
+ * Runs the analysis without opt. The module is loaded lazily, functions are
+ * materialized a batch at a time, analyzed, written and dropped again, hence
+ * only the module level IR and one batch of function bodies are in memory.
+ * The -llvmir++-* options of the pass apply, eg -llvmir++-threads analyzes
+ * the functions of a batch in parallel.
+ *
+ * Several inputs are analyzed on a pool of -jobs workers, every file gets its
+ * own LLVMContext on the worker that loads it. The results go to one file
+ * per input in -output-dir or to one merged JSON Lines stream whose records
+ * carry the name of their module.
+ */
+
+static cl::list<std::string> Inputs(
+    cl::Positional, cl::desc("<input files or directories of .bc/.ll files>"),
+    cl::ZeroOrMore);
+
+static cl::opt<std::string> InputList(
+    "input-list", cl::desc("File listing one input file per line"),
+    cl::value_desc("file"), cl::init(""));
+
+static cl::opt<std::string> OutputFile("o",
+				       cl::desc("Output file (- is stdout)"),
+				       cl::value_desc("file"), cl::init("-"));
+
+static cl::opt<std::string> OutputDir(
+    "output-dir",
+    cl::desc("Write the results of every input to a file of its own in this "
+	     "directory"),
+    cl::value_desc("dir"), cl::init(""));
+
+enum OutputFormat { JSONLinesFormat, BinaryFormat };
+
+static cl::opt<OutputFormat> Format(
+    "format", cl::desc("Output format"),
+    cl::values(clEnumValN(JSONLinesFormat, "jsonl",
+			  "JSON Lines, streamed function by function"),
+	       clEnumValN(BinaryFormat, "binary",
+			  "Binary result format, see ResultFormat.h")),
+    cl::init(JSONLinesFormat));
+
+static cl::list<std::string> OnlyFunctions(
+    "function",
+    cl::desc("Analyze only this function, may be given more than once"),
+    cl::value_desc("name"));
+
+static cl::opt<unsigned> BatchSize(
+    "batch-size",
+    cl::desc("Number of functions materialized at once (0 is four per "
+	     "thread)"),
+    cl::init(0));
+
+static cl::opt<std::string> RemarksOutput(
+    "remarks-output",
+    cl::desc("Write the missed remarks of the analysis as YAML, one input "
+	     "only"),
+    cl::value_desc("file"), cl::init(""));
+
+static cl::opt<unsigned> Jobs(
+    "jobs",
+    cl::desc("Number of input files analyzed in parallel (0 uses all the "
+	     "hardware threads)"),
+    cl::init(0));
+
+static unsigned getHardwareThreads(unsigned Requested) {
+	return Requested ? Requested
+			 : std::max(1u, std::thread::hardware_concurrency());
+}
+
+static bool isInputFile(StringRef Path) {
+	return Path.endswith(".bc") || Path.endswith(".ll");
+}
+
+/* collectInputs
+ * Input files in the order given, the .bc and .ll files of a directory are
+ * taken recursively in the order of their path
+ */
+static bool collectInputs(std::vector<std::string>& Files) {
+	std::vector<std::string> Paths(Inputs.begin(), Inputs.end());
+	if (!InputList.empty()) {
+		auto List = MemoryBuffer::getFileOrSTDIN(InputList);
+		if (!List) {
+			WithColor::error() << InputList << ": "
+					   << List.getError().message() << "\n";
+			return false;
+		}
+		SmallVector<StringRef, 64> Lines;
+		(*List)->getBuffer().split(Lines, '\n', -1, false);
+		for (StringRef Line : Lines) {
+			if (!Line.trim().empty()) {
+				Paths.push_back(Line.trim().str());
+			}
+		}
+	}
+	for (const std::string& Path : Paths) {
+		if (!sys::fs::is_directory(Path)) {
+			Files.push_back(Path);
+			continue;
+		}
+		std::vector<std::string> Found;
+		std::error_code EC;
+		for (sys::fs::recursive_directory_iterator It(Path, EC), End;
+		     It != End && !EC; It.increment(EC)) {
+			if (isInputFile(It->path()) &&
+			    !sys::fs::is_directory(It->path())) {
+				Found.push_back(It->path());
+			}
+		}
+		if (EC) {
+			WithColor::error()
+			    << Path << ": " << EC.message() << "\n";
+			return false;
+		}
+		llvm::sort(Found);
+		Files.insert(Files.end(), Found.begin(), Found.end());
+	}
+	return true;
+}
+
+// Functions to analyze in the order of the module
+static bool selectFunctions(Module& M, std::vector<Function*>& Functions) {
+	if (OnlyFunctions.empty()) {
+		for (Function& F : M) {
+			// Functions not materialized yet are not declarations
+			if (!F.isDeclaration()) {
+				Functions.push_back(&F);
+			}
+		}
+		return true;
+	}
+	bool Found = true;
+	for (const std::string& Name : OnlyFunctions) {
+		Function* F = M.getFunction(Name);
+		if (!F || F->isDeclaration()) {
+			WithColor::error()
+			    << M.getModuleIdentifier()
+			    << ": no function with a body named " << Name << "\n";
+			Found = false;
+		} else if (!is_contained(Functions, F)) {
+			Functions.push_back(F);
+		}
+	}
+	return Found;
+}
+
+/* analyzeFile
+ * Loads the file lazily, then materializes, analyzes, writes and drops its
+ * functions one batch at a time. Flush is called once the records of a batch
+ * are written. Records of a merged stream are tagged with ModuleName.
+ */
+static bool analyzeFile(StringRef Path, raw_ostream& OS, StringRef ModuleName,
+			function_ref<void()> Flush) {
+	TimeTraceScope FileScope("analyzeFile", Path);
+	LLVMContext Context;
+	std::unique_ptr<ToolOutputFile> Remarks;
+	if (!RemarksOutput.empty()) {
+		auto File = setupLLVMOptimizationRemarks(
+		    Context, RemarksOutput, "llvmir\\+\\+", "yaml", false);
+		if (!File) {
+			logAllUnhandledErrors(File.takeError(), WithColor::error(),
+					      RemarksOutput + ": ");
+			return false;
+		}
+		Remarks = std::move(*File);
+		Remarks->keep();
+	}
+	SMDiagnostic Err;
+	std::unique_ptr<Module> M = getLazyIRFileModule(Path, Err, Context);
+	if (!M) {
+		Err.print("llvmir++-tool", errs());
+		return false;
+	}
+	std::vector<Function*> Functions;
+	if (!selectFunctions(*M, Functions)) {
+		return false;
+	}
+	unsigned NumThreads = getHardwareThreads(getNumThreadsOption());
+	size_t Batch = BatchSize ? BatchSize : 4 * NumThreads;
+
+	IRPlusPlusInfo Info;
+	applyCommandLineOptions(Info);
+	BinaryResultWriter Binary(*M);
+	JSONLinesWriter JSONLines(*M, OS);
+	JSONLines.setModuleName(ModuleName);
+	ArrayRef<Function*> Remaining(Functions);
+	while (!Remaining.empty()) {
+		ArrayRef<Function*> Chunk =
+		    Remaining.take_front(std::min(Batch, Remaining.size()));
+		Remaining = Remaining.drop_front(Chunk.size());
+		{
+			TimeTraceScope Scope("Materialize");
+			for (Function* F : Chunk) {
+				if (Error E = F->materialize()) {
+					logAllUnhandledErrors(std::move(E),
+							      WithColor::error(),
+							      Path + ": ");
+					return false;
+				}
+			}
+		}
+		Info.analyze(Chunk, NumThreads);
+		{
+			TimeTraceScope Scope("Write results");
+			for (Function* F : Chunk) {
+				if (Format == BinaryFormat) {
+					Binary.addFunction(*F, Info);
+				} else {
+					JSONLines.addFunction(*F, Info);
+				}
+			}
+		}
+		// The results point into the bodies, they go first
+		Info.clear();
+		for (Function* F : Chunk) {
+			F->deleteBody();
+		}
+		Flush();
+	}
+	if (Format == BinaryFormat) {
+		TimeTraceScope Scope("Write results");
+		Binary.write(OS);
+	}
+	return true;
+}
+
+// Output of an input in -output-dir, named after the input file
+static std::string getOutputPath(StringRef Input) {
+	SmallString<128> Path(OutputDir);
+	sys::path::append(Path, sys::path::filename(Input));
+	Path += Format == BinaryFormat ? ".irpb" : ".jsonl";
+	return Path.str().str();
+}
+
+/* analyzeFiles
+ * Analyzes every file on its own output in -output-dir
+ */
+static bool analyzeFiles(ArrayRef<std::string> Files, unsigned NumJobs) {
+	StringSet<> Outputs;
+	for (const std::string& File : Files) {
+		if (!Outputs.insert(getOutputPath(File)).second) {
+			WithColor::error() << "several inputs are named "
+					   << sys::path::filename(File) << "\n";
+			return false;
+		}
+	}
+	if (std::error_code EC = sys::fs::create_directories(OutputDir)) {
+		WithColor::error() << OutputDir << ": " << EC.message() << "\n";
+		return false;
+	}
+	std::atomic<bool> Failed(false);
+	parallelFor(NumJobs, Files.size(), [&](size_t I) {
+		bool Analyzed = false;
+		bool Written = writeFile(
+		    getOutputPath(Files[I]), 1 << 16, [&](raw_ostream& OS) {
+			    Analyzed = analyzeFile(Files[I], OS, "", [] {});
+		    });
+		if (!Analyzed || !Written) {
+			Failed = true;
+		}
+	});
+	return !Failed;
+}
+
+/* analyzeMerged
+ * Analyzes every file into one JSON Lines stream. Every worker buffers the
+ * records of the current batch of its file and appends them to the stream
+ * under a lock, records of different files are interleaved but each one
+ * names its module.
+ */
+static bool analyzeMerged(ArrayRef<std::string> Files, unsigned NumJobs) {
+	std::atomic<bool> Failed(false);
+	std::mutex Lock;
+	bool Written = writeFile(OutputFile, 1 << 16, [&](raw_ostream& Merged) {
+		parallelFor(NumJobs, Files.size(), [&](size_t I) {
+			std::string Buffer;
+			raw_string_ostream OS(Buffer);
+			auto Flush = [&]() {
+				OS.flush();
+				std::lock_guard<std::mutex> Guard(Lock);
+				Merged << Buffer;
+				Buffer.clear();
+			};
+			if (!analyzeFile(Files[I], OS, Files[I], Flush)) {
+				Failed = true;
+			}
+			Flush();
+		});
+	});
+	return Written && !Failed;
+}
+
+/* printStatistics
+ * The statistics of the analysis are counted whatever the build of LLVM but
+ * a release build of LLVM does not print them at exit, it only notes that
+ * its own are disabled. They are printed here and reset, hence a build with
+ * assertions does not print them a second time at exit.
+ */
+static void printStatistics() {
+	if (!AreStatisticsEnabled()) {
+		return;
+	}
+	cl::Option* AsJSON = cl::getRegisteredOptions().lookup("stats-json");
+	if (AsJSON && AsJSON->getNumOccurrences()) {
+		PrintStatisticsJSON(errs());
+	} else {
+		PrintStatistics(errs());
+	}
+	ResetStatistics();
+}
+
+static int run() {
+	std::vector<std::string> Files;
+	if (!collectInputs(Files)) {
+		return 1;
+	}
+	if (Files.empty()) {
+		WithColor::error() << "no input files\n";
+		return 1;
+	}
+	if (!RemarksOutput.empty() && Files.size() > 1) {
+		WithColor::error() << "-remarks-output takes one input\n";
+		return 1;
+	}
+	unsigned NumJobs = getHardwareThreads(Jobs);
+	if (!OutputDir.empty()) {
+		return analyzeFiles(Files, NumJobs) ? 0 : 1;
+	}
+	if (Files.size() == 1) {
+		bool Analyzed = false;
+		bool Written =
+		    writeFile(OutputFile, 1 << 16, [&](raw_ostream& OS) {
+			    Analyzed = analyzeFile(Files[0], OS, "", [] {});
+		    });
+		return Analyzed && Written ? 0 : 1;
+	}
+	if (Format == BinaryFormat) {
+		WithColor::error() << "binary results of several inputs can not "
+				      "be merged, use -output-dir\n";
+		return 1;
+	}
+	return analyzeMerged(Files, NumJobs) ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+	InitLLVM X(argc, argv);
+	cl::ParseCommandLineOptions(argc, argv, "LLVM IR++ driver\n");
+	int Status;
+	{
+		TimeTraceSession Trace;
+		Status = run();
+	}
+	printStatistics();
+	return Status;
+}
@@ -0,0 +1,543 @@
+#include "include/PointsTo.h"
+#include "llvm/Support/TimeProfiler.h"
+
+using namespace llvm;
+
+unsigned AndersenPointsTo::createNode(Value* V) {
+	unsigned Id = Nodes.size();
+	Nodes.emplace_back();
+	Rep.push_back(Id);
+	Values.push_back(V);
+	InWorkList.push_back(false);
+	return Id;
+}
+
+unsigned AndersenPointsTo::getNode(Value* V) {
+	auto It = NodeIds.find(V);
+	if (It != NodeIds.end()) {
+		return It->second;
+	}
+	unsigned Id = createNode(V);
+	NodeIds[V] = Id;
+	return Id;
+}
+
+// Representative of a node with path halving
+unsigned AndersenPointsTo::find(unsigned N) {
+	while (Rep[N] != N) {
+		Rep[N] = Rep[Rep[N]];
+		N = Rep[N];
+	}
+	return N;
+}
+
+void AndersenPointsTo::push(unsigned N) {
+	if (!InWorkList[N]) {
+		InWorkList[N] = true;
+		WorkList.push_back(N);
+	}
+}
+
+/* addConstraints
+ * Translates one statement, see the table in PointsTo.h
+ */
+void AndersenPointsTo::addConstraints(UpdateInst* U) {
+	Value* LHSVar = getVariable(U->LHS);
+	if (!LHSVar) {
+		return;
+	}
+	unsigned Dst = getNode(LHSVar);
+	bool StoreThrough =
+	    U->LHS->symbol == pointer || U->LHS->symbol == arrow;
+	// The node receiving the RHS, a temporary when the LHS is a store
+	// and the RHS is not a plain copy
+	auto Target = [&]() {
+		if (!StoreThrough) {
+			return Dst;
+		}
+		unsigned Tmp = createNode(nullptr);
+		Nodes[Dst].Stores.push_back(Tmp);
+		return Tmp;
+	};
+	// Adds Obj to the points-to set of the receiving node, both are
+	// created before indexing Nodes as creating a node may reallocate it
+	auto AddressOf = [&](Value* Obj) {
+		unsigned O = getNode(Obj);
+		unsigned Tgt = Target();
+		Nodes[Tgt].PointsTo.set(O);
+	};
+	Expression* R = U->RHS;
+	switch (R->symbol) {
+		case newObj:
+			AddressOf(U->Inst);
+			break;
+		case address:
+			// Spilling an argument is abstracted as &arg, its value
+			// is copied rather than its address
+			if (!R->base && R->functionArg &&
+			    isa<Argument>(R->functionArg)) {
+				unsigned Src = getNode(R->functionArg);
+				if (StoreThrough) {
+					Nodes[Dst].Stores.push_back(Src);
+				} else {
+					Nodes[Src].Copy.set(Dst);
+				}
+			} else if (Value* RHSVar = getVariable(R)) {
+				AddressOf(RHSVar);
+			}
+			break;
+		case simple:
+		case dot:
+			// A global stored directly is abstracted as a simple RHS
+			// but its address is what is stored
+			if (isa<GlobalVariable>(U->Inst->getValueOperand())) {
+				AddressOf(U->Inst->getValueOperand());
+			} else if (Value* RHSVar = getVariable(R)) {
+				unsigned Src = getNode(RHSVar);
+				if (StoreThrough) {
+					Nodes[Dst].Stores.push_back(Src);
+				} else {
+					Nodes[Src].Copy.set(Dst);
+				}
+			}
+			break;
+		case pointer:
+		case arrow:
+			if (Value* RHSVar = getVariable(R)) {
+				unsigned Src = getNode(RHSVar);
+				unsigned Tgt = Target();
+				Nodes[Src].Loads.push_back(Tgt);
+			}
+			break;
+		case constant:
+			break;
+	}
+}
+
+AndersenPointsTo::AndersenPointsTo(const MetaDataStore& IRPlusPlus) {
+	TimeTraceScope Scope("AndersenPointsTo");
+	for (UpdateInst* U : IRPlusPlus) {
+		addConstraints(U);
+	}
+	solve();
+}
+
+bool AndersenPointsTo::addCopyEdge(unsigned From, unsigned To) {
+	if (From == To || Nodes[From].Copy.test(To)) {
+		return false;
+	}
+	Nodes[From].Copy.set(To);
+	if (Nodes[To].PointsTo |= Nodes[From].PointsTo) {
+		push(To);
+	}
+	return true;
+}
+
+/* collapse
+ * Merges N into Into. The propagated part of the merged node is what both
+ * had propagated, the rest is propagated again.
+ */
+void AndersenPointsTo::collapse(unsigned Into, unsigned N) {
+	ConstraintNode& To = Nodes[Into];
+	ConstraintNode& From = Nodes[N];
+	Rep[N] = Into;
+	To.PointsTo |= From.PointsTo;
+	To.Propagated &= From.Propagated;
+	To.Copy |= From.Copy;
+	To.Loads.append(From.Loads.begin(), From.Loads.end());
+	To.Stores.append(From.Stores.begin(), From.Stores.end());
+	From = ConstraintNode();
+	NumCollapsed++;
+	push(Into);
+}
+
+/* collapseCycles
+ * Iterative Tarjan over the copy edges reachable from Root, every strongly
+ * connected component is collapsed into its root
+ */
+void AndersenPointsTo::collapseCycles(unsigned Root) {
+	DenseMap<unsigned, unsigned> Index, Low;
+	std::vector<unsigned> Stack;
+	DenseSet<unsigned> OnStack;
+	std::vector<std::vector<unsigned>> Components;
+	// Node and its remaining successors
+	std::vector<std::pair<unsigned, std::vector<unsigned>>> DFS;
+	auto Visit = [&](unsigned N) {
+		Index[N] = Low[N] = Index.size();
+		Stack.push_back(N);
+		OnStack.insert(N);
+		std::vector<unsigned> Succs;
+		for (unsigned S : Nodes[N].Copy) {
+			S = find(S);
+			if (S != N) {
+				Succs.push_back(S);
+			}
+		}
+		DFS.push_back({N, std::move(Succs)});
+	};
+	Visit(Root);
+	while (!DFS.empty()) {
+		unsigned N = DFS.back().first;
+		std::vector<unsigned>& Succs = DFS.back().second;
+		if (!Succs.empty()) {
+			unsigned S = Succs.back();
+			Succs.pop_back();
+			if (!Index.count(S)) {
+				Visit(S);
+			} else if (OnStack.count(S)) {
+				Low[N] = std::min(Low[N], Index[S]);
+			}
+			continue;
+		}
+		DFS.pop_back();
+		if (!DFS.empty()) {
+			unsigned Parent = DFS.back().first;
+			Low[Parent] = std::min(Low[Parent], Low[N]);
+		}
+		if (Low[N] != Index[N]) {
+			continue;
+		}
+		std::vector<unsigned> Component;
+		unsigned M;
+		do {
+			M = Stack.back();
+			Stack.pop_back();
+			OnStack.erase(M);
+			Component.push_back(M);
+		} while (M != N);
+		if (Component.size() > 1) {
+			Components.push_back(std::move(Component));
+		}
+	}
+	for (auto& Component : Components) {
+		for (unsigned M : Component) {
+			if (M != Component.back()) {
+				collapse(Component.back(), M);
+			}
+		}
+	}
+}
+
+/* solve
+ * Worklist iteration with difference propagation. Complex constraints add
+ * copy edges for the newly found objects only. A copy edge that makes the
+ * sets of its ends equal hints at a cycle and is checked once.
+ */
+void AndersenPointsTo::solve() {
+	TimeTraceScope Scope("AndersenPointsTo::solve");
+	for (unsigned N = 0; N < Nodes.size(); N++) {
+		if (!Nodes[N].PointsTo.empty()) {
+			push(N);
+		}
+	}
+	while (!WorkList.empty()) {
+		unsigned N = WorkList.back();
+		WorkList.pop_back();
+		InWorkList[N] = false;
+		if (find(N) != N) {
+			continue;
+		}
+		SparseBitVector<> Delta = Nodes[N].PointsTo;
+		Delta.intersectWithComplement(Nodes[N].Propagated);
+		if (Delta.empty()) {
+			continue;
+		}
+		Nodes[N].Propagated = Nodes[N].PointsTo;
+		for (unsigned Obj : Delta) {
+			unsigned O = find(Obj);
+			for (unsigned L : Nodes[N].Loads) {
+				addCopyEdge(O, find(L));
+			}
+			for (unsigned S : Nodes[N].Stores) {
+				addCopyEdge(find(S), O);
+			}
+		}
+		// Copied out of the node as collapsing cycles modifies the edges
+		std::vector<unsigned> Succs;
+		for (unsigned S : Nodes[N].Copy) {
+			Succs.push_back(S);
+		}
+		for (unsigned S : Succs) {
+			S = find(S);
+			if (S == N) {
+				continue;
+			}
+			if (Nodes[S].PointsTo |= Delta) {
+				push(S);
+			}
+			if (Nodes[S].PointsTo == Nodes[N].PointsTo &&
+			    CheckedEdges.insert({N, S}).second) {
+				collapseCycles(S);
+				N = find(N);
+			}
+		}
+	}
+}
+
+const SparseBitVector<>& AndersenPointsTo::getPointsTo(Value* V) {
+	static const SparseBitVector<> Empty;
+	auto It = NodeIds.find(V);
+	if (It == NodeIds.end()) {
+		return Empty;
+	}
+	return Nodes[find(It->second)].PointsTo;
+}
+
+bool AndersenPointsTo::mayPointTo(Value* P, Value* Obj) {
+	auto It = NodeIds.find(Obj);
+	return It != NodeIds.end() && getPointsTo(P).test(It->second);
+}
+
+bool AndersenPointsTo::mayAlias(Value* P, Value* Q) {
+	return getPointsTo(P).intersects(getPointsTo(Q));
+}
+
+const unsigned SteensgaardPointsTo::NoNode;
+
+unsigned SteensgaardPointsTo::createNode() {
+	unsigned Id = Rep.size();
+	Rep.push_back(Id);
+	Rank.push_back(0);
+	Pointee.push_back(NoNode);
+	Fields.emplace_back();
+	return Id;
+}
+
+unsigned SteensgaardPointsTo::getNode(Value* V) {
+	auto It = NodeIds.find(V);
+	if (It != NodeIds.end()) {
+		return find(It->second);
+	}
+	unsigned Id = createNode();
+	NodeIds[V] = Id;
+	return Id;
+}
+
+unsigned SteensgaardPointsTo::find(unsigned N) {
+	while (Rep[N] != N) {
+		Rep[N] = Rep[Rep[N]];
+		N = Rep[N];
+	}
+	return N;
+}
+
+// Class pointed to by N, a fresh one if N points nowhere yet
+unsigned SteensgaardPointsTo::getPointee(unsigned N) {
+	N = find(N);
+	if (Pointee[N] == NoNode) {
+		unsigned P = createNode();
+		Pointee[N] = P;
+		return P;
+	}
+	return find(Pointee[N]);
+}
+
+unsigned SteensgaardPointsTo::getField(unsigned N, Value* Field) {
+	N = find(N);
+	for (auto& F : Fields[N]) {
+		if (F.first == Field) {
+			return find(F.second);
+		}
+	}
+	unsigned F = createNode();
+	Fields[N].push_back({Field, F});
+	return F;
+}
+
+unsigned SteensgaardPointsTo::getLocation(Expression* Exp) {
+	unsigned N = getNode(getVariable(Exp));
+	switch (Exp->symbol) {
+		case dot:
+			return getField(N, Exp->optional);
+		case pointer:
+			return getPointee(N);
+		case arrow:
+			return getField(getPointee(N), Exp->optional);
+		default:
+			return N;
+	}
+}
+
+/* getValue
+ * The argument and global special cases match AndersenPointsTo
+ */
+unsigned SteensgaardPointsTo::getValue(UpdateInst* U) {
+	Expression* R = U->RHS;
+	if (R->symbol == newObj) {
+		return getNode(U->Inst);
+	}
+	if (R->symbol == constant) {
+		return NoNode;
+	}
+	Value* Stored = U->Inst->getValueOperand();
+	if (isa<GlobalVariable>(Stored) && R->symbol != address) {
+		return getNode(Stored);
+	}
+	if (!getVariable(R)) {
+		return NoNode;
+	}
+	if (R->symbol == address &&
+	    !(!R->base && R->functionArg && isa<Argument>(R->functionArg))) {
+		return getLocation(R);
+	}
+	return getPointee(getLocation(R));
+}
+
+SteensgaardPointsTo::SteensgaardPointsTo(const MetaDataStore& IRPlusPlus) {
+	TimeTraceScope Scope("SteensgaardPointsTo");
+	for (UpdateInst* U : IRPlusPlus) {
+		if (!getVariable(U->LHS)) {
+			continue;
+		}
+		unsigned Value = getValue(U);
+		if (Value != NoNode) {
+			join(getPointee(getLocation(U->LHS)), Value);
+		}
+	}
+}
+
+void SteensgaardPointsTo::join(unsigned A, unsigned B) {
+	Pending.push_back({A, B});
+	while (!Pending.empty()) {
+		auto P = Pending.back();
+		Pending.pop_back();
+		unify(P.first, P.second);
+	}
+}
+
+/* unify
+ * Union by rank, the pointees and the common fields of both classes are
+ * unified in turn
+ */
+void SteensgaardPointsTo::unify(unsigned A, unsigned B) {
+	A = find(A);
+	B = find(B);
+	if (A == B) {
+		return;
+	}
+	if (Rank[A] < Rank[B]) {
+		std::swap(A, B);
+	}
+	if (Rank[A] == Rank[B]) {
+		Rank[A]++;
+	}
+	Rep[B] = A;
+	if (Pointee[B] != NoNode) {
+		if (Pointee[A] == NoNode) {
+			Pointee[A] = Pointee[B];
+		} else {
+			Pending.push_back({Pointee[A], Pointee[B]});
+		}
+	}
+	for (auto& FB : Fields[B]) {
+		auto It = find_if(Fields[A], [&](std::pair<Value*, unsigned>& FA) {
+			return FA.first == FB.first;
+		});
+		if (It == Fields[A].end()) {
+			Fields[A].push_back(FB);
+		} else {
+			Pending.push_back({It->second, FB.second});
+		}
+	}
+	Fields[B].clear();
+}
+
+unsigned SteensgaardPointsTo::lookupPointee(Value* V) {
+	auto It = NodeIds.find(V);
+	if (It == NodeIds.end()) {
+		return NoNode;
+	}
+	unsigned P = Pointee[find(It->second)];
+	return P == NoNode ? NoNode : find(P);
+}
+
+bool SteensgaardPointsTo::mayPointTo(Value* P, Value* Obj) {
+	unsigned Target = lookupPointee(P);
+	auto It = NodeIds.find(Obj);
+	return Target != NoNode && It != NodeIds.end() &&
+	       find(It->second) == Target;
+}
+
+bool SteensgaardPointsTo::mayAlias(Value* P, Value* Q) {
+	unsigned PT = lookupPointee(P);
+	return PT != NoNode && PT == lookupPointee(Q);
+}
+
+/* getObjects
+ * Variables and heap objects of the statements in the order they appear,
+ * the candidates of a points-to query
+ */
+static SetVector<Value*> getObjects(const MetaDataStore& IRPlusPlus) {
+	SetVector<Value*> Objects;
+	for (UpdateInst* U : IRPlusPlus) {
+		if (Value* V = getVariable(U->LHS)) {
+			Objects.insert(V);
+		}
+		if (U->RHS->symbol == newObj) {
+			Objects.insert(U->Inst);
+		} else if (Value* V = getVariable(U->RHS)) {
+			Objects.insert(V);
+		}
+		if (isa<GlobalVariable>(U->Inst->getValueOperand())) {
+			Objects.insert(U->Inst->getValueOperand());
+		}
+	}
+	return Objects;
+}
+
+static void printObject(raw_ostream& OS, Value* V) {
+	if (StoreInst* SI = dyn_cast<StoreInst>(V)) {
+		OS << "new ";
+		V = SI->getValueOperand();
+	}
+	V->printAsOperand(OS, false);
+}
+
+/* printPointsTo
+ * One line per object that may point somewhere, the objects are compared
+ * pairwise through mayPointTo
+ */
+template <typename PointsToT>
+static void printPointsTo(raw_ostream& OS, const MetaDataStore& IRPlusPlus,
+			  PointsToT& PointsTo) {
+	SetVector<Value*> Objects = getObjects(IRPlusPlus);
+	for (Value* P : Objects) {
+		bool First = true;
+		for (Value* Obj : Objects) {
+			if (!PointsTo.mayPointTo(P, Obj)) {
+				continue;
+			}
+			if (First) {
+				OS << "  ";
+				printObject(OS, P);
+				OS << " ->";
+				First = false;
+			}
+			OS << " ";
+			printObject(OS, Obj);
+		}
+		if (!First) {
+			OS << "\n";
+		}
+	}
+}
+
+PreservedAnalyses AndersenPrinterPass::run(Module& M,
+					   ModuleAnalysisManager& MAM) {
+	const MetaDataStore& IRPlusPlus =
+	    MAM.getResult<IRPlusPlusAnalysis>(M).getIRPlusPlus();
+	AndersenPointsTo PointsTo(IRPlusPlus);
+	OS << "Andersen points-to of " << M.getName() << ":\n";
+	printPointsTo(OS, IRPlusPlus, PointsTo);
+	return PreservedAnalyses::all();
+}
+
+PreservedAnalyses SteensgaardPrinterPass::run(Module& M,
+					      ModuleAnalysisManager& MAM) {
+	const MetaDataStore& IRPlusPlus =
+	    MAM.getResult<IRPlusPlusAnalysis>(M).getIRPlusPlus();
+	SteensgaardPointsTo PointsTo(IRPlusPlus);
+	OS << "Steensgaard points-to of " << M.getName() << ":\n";
+	printPointsTo(OS, IRPlusPlus, PointsTo);
+	return PreservedAnalyses::all();
+}
@@ -0,0 +1,484 @@
+#include "include/ResultWriter.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/TimeProfiler.h"
+
+using namespace llvm;
+
+static_assert(irpp::NewObjSymbol == unsigned(newObj) &&
+		  irpp::AddressSymbol == unsigned(address),
+	      "irpp::Symbol must follow SymbolType");
+static_assert(irpp::CallNode == unsigned(call) &&
+		  irpp::IntrinsicCall == unsigned(intrinsic),
+	      "irpp::NodeKind and irpp::CallKind must follow InstType and "
+	      "CallType");
+
+/* getValueName
+ * Name of the value, or the value printed as an operand if it has none.
+ * Stores and void calls have no slot, they are named by their opcode.
+ */
+static std::string getValueName(const Value* V, ModuleSlotTracker& Slots) {
+	if (V->hasName()) {
+		return V->getName().str();
+	}
+	if (V->getType()->isVoidTy()) {
+		return cast<Instruction>(V)->getOpcodeName();
+	}
+	std::string Name;
+	raw_string_ostream OS(Name);
+	V->printAsOperand(OS, false, Slots);
+	return OS.str();
+}
+
+/* getFieldPath
+ * Names a field access by its source element type and its indices. Which GEP
+ * is canonical for a field depends on the functions analyzed together, the
+ * field path does not.
+ */
+static std::string getFieldPath(const GetElementPtrInst* GEP,
+				ModuleSlotTracker& Slots) {
+	std::string Path;
+	raw_string_ostream OS(Path);
+	GEP->getSourceElementType()->print(OS, false, true);
+	for (const Use& Idx : GEP->indices()) {
+		OS << ", ";
+		Idx->printAsOperand(OS, true, Slots);
+	}
+	return OS.str();
+}
+
+uint32_t BinaryResultWriter::addString(StringRef S) {
+	auto Inserted = StringIds.insert({S, Strings.size()});
+	if (Inserted.second) {
+		Strings.append(S.begin(), S.end());
+		Strings.push_back('\0');
+	}
+	return Inserted.first->second;
+}
+
+uint32_t BinaryResultWriter::addType(Type* T) {
+	if (!T) {
+		return irpp::NoIndex;
+	}
+	auto It = TypeIds.find(T);
+	if (It != TypeIds.end()) {
+		return It->second;
+	}
+	std::string Name;
+	raw_string_ostream OS(Name);
+	T->print(OS);
+	irpp::TypeRecord Record = {addString(OS.str())};
+	uint32_t Id = Types.size();
+	Types.push_back(Record);
+	TypeIds[T] = Id;
+	return Id;
+}
+
+uint32_t BinaryResultWriter::addValue(const Value* V) {
+	if (!V) {
+		return irpp::NoIndex;
+	}
+	auto It = ValueIds.find(V);
+	if (It != ValueIds.end()) {
+		return It->second;
+	}
+	irpp::ValueRecord Record = {addString(getValueName(V, Slots)),
+				    irpp::OtherValue, irpp::NoIndex, 0};
+	// A canonical GEP may belong to another function than the one added
+	auto GetFunction = [&](const Function* F) {
+		auto It = FunctionIds.find(F);
+		return It == FunctionIds.end() ? irpp::NoIndex : It->second;
+	};
+	if (const Instruction* I = dyn_cast<Instruction>(V)) {
+		Record.Kind = irpp::InstructionValue;
+		Record.Function = GetFunction(I->getFunction());
+		if (const DebugLoc& Loc = I->getDebugLoc()) {
+			Record.Line = Loc.getLine();
+		}
+	} else if (const Argument* A = dyn_cast<Argument>(V)) {
+		Record.Kind = irpp::ArgumentValue;
+		Record.Function = GetFunction(A->getParent());
+	} else if (isa<Function>(V)) {
+		Record.Kind = irpp::FunctionValue;
+	} else if (isa<GlobalVariable>(V)) {
+		Record.Kind = irpp::GlobalVariableValue;
+	} else if (isa<Constant>(V)) {
+		Record.Kind = irpp::ConstantValue;
+	}
+	uint32_t Id = Values.size();
+	Values.push_back(Record);
+	ValueIds[V] = Id;
+	return Id;
+}
+
+// Field accesses are written as field path values
+uint32_t BinaryResultWriter::addOptional(const Value* V) {
+	const GetElementPtrInst* GEP = dyn_cast_or_null<GetElementPtrInst>(V);
+	if (!GEP) {
+		return addValue(V);
+	}
+	uint32_t Name = addString(getFieldPath(GEP, Slots));
+	auto Inserted = FieldPathIds.insert({Name, Values.size()});
+	if (Inserted.second) {
+		Values.push_back(
+		    {Name, irpp::FieldPathValue, irpp::NoIndex, 0});
+	}
+	return Inserted.first->second;
+}
+
+uint32_t BinaryResultWriter::addExpression(const Expression* E) {
+	if (!E) {
+		return irpp::NoIndex;
+	}
+	auto It = ExpressionIds.find(E);
+	if (It != ExpressionIds.end()) {
+		return It->second;
+	}
+	irpp::ExpressionRecord Record = {
+	    addValue(E->base),	      addOptional(E->optional),
+	    addType(E->type),	      uint32_t(E->symbol),
+	    addValue(E->functionArg), E->RHSisAddress};
+	uint32_t Id = Expressions.size();
+	Expressions.push_back(Record);
+	ExpressionIds[E] = Id;
+	return Id;
+}
+
+/* addFunction
+ * Adds the statements of the function in the order of the instructions, then
+ * the nodes of its abstracted cfg in the order of their id
+ */
+void BinaryResultWriter::addFunction(Function& F, IRPlusPlusInfo& Info) {
+	CFG* G = Info.getCFG(&F);
+	Slots.incorporateFunction(F);
+	irpp::FunctionRecord Record = {addString(F.getName()), addValue(&F),
+				       uint32_t(Statements.size()), 0,
+				       uint32_t(Nodes.size()), 0};
+	uint32_t FunctionId = Functions.size();
+	FunctionIds[&F] = FunctionId;
+	DenseMap<const StoreInst*, uint32_t> StatementIds;
+	for (Instruction& I : instructions(F)) {
+		StoreInst* StoreI = dyn_cast<StoreInst>(&I);
+		UpdateInst* UpdateI =
+		    StoreI ? Info.getIRPlusPlus().lookup(StoreI) : nullptr;
+		if (!UpdateI) {
+			continue;
+		}
+		Node* N = G ? G->getNode(StoreI) : nullptr;
+		StatementIds[StoreI] = Statements.size();
+		Statements.push_back(
+		    {FunctionId, addValue(StoreI), addExpression(UpdateI->LHS),
+		     addExpression(UpdateI->RHS),
+		     N && G->isAbstracted(N) ? N->Id : irpp::NoIndex});
+	}
+	Record.NumStatements = Statements.size() - Record.FirstStatement;
+	if (G && G->getStartNode()) {
+		for (Node* N : G->getAbstractedNodes()) {
+			irpp::NodeRecord NodeRec = {
+			    N->Inst ? addValue(N->Inst) : irpp::NoIndex,
+			    uint32_t(N->abstractedInto),
+			    irpp::NoIndex,
+			    irpp::DirectCall,
+			    irpp::NoIndex,
+			    irpp::NoIndex,
+			    irpp::NoIndex};
+			if (N->abstractedInto == update) {
+				auto It = StatementIds.find(
+				    cast<StoreInst>(N->Inst));
+				if (It != StatementIds.end()) {
+					NodeRec.Statement = It->second;
+				}
+			} else if (N->abstractedInto == call) {
+				NodeRec.Call = N->callType;
+				NodeRec.Callee = addValue(N->Func);
+				NodeRec.CalleeExpression = addExpression(N->Callee);
+				NodeRec.Receiver = addExpression(
+				    Info.getIRPlusPlus().lookupReceiver(
+					cast<CallInst>(N->Inst)));
+			}
+			Nodes.push_back(NodeRec);
+			for (Node* S : N->getSucc()) {
+				Succs.push_back(S->Id);
+			}
+			for (Node* P : N->getPred()) {
+				Preds.push_back(P->Id);
+			}
+			SuccOffsets.push_back(Succs.size());
+			PredOffsets.push_back(Preds.size());
+		}
+	}
+	Record.NumNodes = Nodes.size() - Record.FirstNode;
+	Functions.push_back(Record);
+	forgetLocals(F);
+}
+
+// Local values are only referred to by their own function, the addresses of
+// a dropped function and of its expressions may be reused by the next one
+void BinaryResultWriter::forgetLocals(Function& F) {
+	for (Argument& A : F.args()) {
+		ValueIds.erase(&A);
+	}
+	for (Instruction& I : instructions(F)) {
+		ValueIds.erase(&I);
+	}
+	ExpressionIds.clear();
+}
+
+// Records are written word by word in little endian
+template <typename T>
+static void writeRecords(support::endian::Writer& W,
+			 const std::vector<T>& Records) {
+	static_assert(sizeof(T) % 4 == 0 && std::is_trivially_copyable<T>::value,
+		      "records are made of 32 bit words");
+	for (const T& Record : Records) {
+		uint32_t Words[sizeof(T) / 4];
+		memcpy(Words, &Record, sizeof(T));
+		for (uint32_t Word : Words) {
+			W.write<uint32_t>(Word);
+		}
+	}
+}
+
+static uint64_t alignSection(uint64_t Offset) { return alignTo(Offset, 8); }
+
+void BinaryResultWriter::write(raw_ostream& OS) {
+	support::endian::Writer W(OS, support::little);
+	uint64_t Counts[irpp::NumSections] = {
+	    Strings.size(),    Types.size(),	   Values.size(),
+	    Expressions.size(), Statements.size(), Functions.size(),
+	    Nodes.size(),      SuccOffsets.size(), Succs.size(),
+	    PredOffsets.size(), Preds.size()};
+	uint64_t RecordSizes[irpp::NumSections] = {
+	    1,
+	    sizeof(irpp::TypeRecord),
+	    sizeof(irpp::ValueRecord),
+	    sizeof(irpp::ExpressionRecord),
+	    sizeof(irpp::StatementRecord),
+	    sizeof(irpp::FunctionRecord),
+	    sizeof(irpp::NodeRecord),
+	    4,
+	    4,
+	    4,
+	    4};
+	uint64_t Offsets[irpp::NumSections];
+	uint64_t Offset = sizeof(irpp::FileHeader);
+	for (unsigned Id = 0; Id < irpp::NumSections; Id++) {
+		Offsets[Id] = Offset = alignSection(Offset);
+		Offset += Counts[Id] * RecordSizes[Id];
+	}
+
+	OS.write(irpp::FileMagic, 4);
+	W.write<uint32_t>(irpp::FormatVersion);
+	W.write<uint32_t>(irpp::NumSections);
+	W.write<uint32_t>(0);
+	for (unsigned Id = 0; Id < irpp::NumSections; Id++) {
+		W.write<uint64_t>(Offsets[Id]);
+		W.write<uint64_t>(Counts[Id]);
+	}
+	uint64_t Written = sizeof(irpp::FileHeader);
+	auto Pad = [&](unsigned Id) {
+		OS.write_zeros(Offsets[Id] - Written);
+		Written = Offsets[Id] + Counts[Id] * RecordSizes[Id];
+	};
+	Pad(irpp::StringSection);
+	OS << Strings;
+	Pad(irpp::TypeSection);
+	writeRecords(W, Types);
+	Pad(irpp::ValueSection);
+	writeRecords(W, Values);
+	Pad(irpp::ExpressionSection);
+	writeRecords(W, Expressions);
+	Pad(irpp::StatementSection);
+	writeRecords(W, Statements);
+	Pad(irpp::FunctionSection);
+	writeRecords(W, Functions);
+	Pad(irpp::NodeSection);
+	writeRecords(W, Nodes);
+	Pad(irpp::SuccOffsetSection);
+	writeRecords(W, SuccOffsets);
+	Pad(irpp::SuccSection);
+	writeRecords(W, Succs);
+	Pad(irpp::PredOffsetSection);
+	writeRecords(W, PredOffsets);
+	Pad(irpp::PredSection);
+	writeRecords(W, Preds);
+}
+
+void writeResults(Module& M, IRPlusPlusInfo& Info, raw_ostream& OS) {
+	TimeTraceScope Scope("writeResults");
+	BinaryResultWriter Writer(M);
+	for (Function& F : M) {
+		if (!F.isDeclaration()) {
+			Writer.addFunction(F, Info);
+		}
+	}
+	Writer.write(OS);
+}
+
+static const char* const SymbolNames[] = {
+    "simple", "pointer", "arrow", "dot", "constant", "address", "newObj"};
+static const char* const NodeKindNames[] = {"ir", "update", "call"};
+static const char* const CallTypeNames[] = {"direct", "indirect", "virtual",
+					    "intrinsic"};
+
+// Attributes every record starts with
+void JSONLinesWriter::writeHeader(json::OStream& J, StringRef Record,
+				  Function& F) {
+	J.attribute("record", Record);
+	if (!ModuleName.empty()) {
+		J.attribute("module", json::isUTF8(ModuleName)
+					  ? ModuleName
+					  : json::fixUTF8(ModuleName));
+	}
+	attribute(J, "function", &F);
+}
+
+void JSONLinesWriter::attribute(json::OStream& J, StringRef Key,
+				const Value* V) {
+	if (V) {
+		std::string Name = getValueName(V, Slots);
+		J.attribute(Key, json::isUTF8(Name) ? Name : json::fixUTF8(Name));
+	}
+}
+
+// Field accesses are written as their field path
+void JSONLinesWriter::optional(json::OStream& J, const Value* V) {
+	if (const GetElementPtrInst* GEP = dyn_cast_or_null<GetElementPtrInst>(V)) {
+		std::string Path = getFieldPath(GEP, Slots);
+		J.attribute("optional",
+			    json::isUTF8(Path) ? Path : json::fixUTF8(Path));
+	} else {
+		attribute(J, "optional", V);
+	}
+}
+
+void JSONLinesWriter::attribute(json::OStream& J, StringRef Key,
+				const Expression* E) {
+	if (!E) {
+		return;
+	}
+	J.attributeObject(Key, [&] {
+		J.attribute("symbol", SymbolNames[E->symbol]);
+		attribute(J, "base", E->base);
+		optional(J, E->optional);
+		attribute(J, "functionArg", E->functionArg);
+		if (E->type) {
+			std::string Type;
+			raw_string_ostream TypeOS(Type);
+			E->type->print(TypeOS);
+			J.attribute("type", TypeOS.str());
+		}
+		J.attribute("address", E->RHSisAddress);
+	});
+}
+
+void JSONLinesWriter::addFunction(Function& F, IRPlusPlusInfo& Info) {
+	CFG* G = Info.getCFG(&F);
+	Slots.incorporateFunction(F);
+	bool HasCFG = G && G->getStartNode();
+	json::OStream J(OS);
+	J.object([&] {
+		writeHeader(J, "function", F);
+		J.attribute("nodes",
+			    HasCFG ? int64_t(G->getAbstractedNodes().size()) : 0);
+	});
+	OS << '\n';
+	for (Instruction& I : instructions(F)) {
+		StoreInst* StoreI = dyn_cast<StoreInst>(&I);
+		UpdateInst* UpdateI =
+		    StoreI ? Info.getIRPlusPlus().lookup(StoreI) : nullptr;
+		if (!UpdateI) {
+			continue;
+		}
+		Node* N = G ? G->getNode(StoreI) : nullptr;
+		json::OStream J(OS);
+		J.object([&] {
+			writeHeader(J, "statement", F);
+			if (N && G->isAbstracted(N)) {
+				J.attribute("node", int64_t(N->Id));
+			}
+			if (const DebugLoc& Loc = StoreI->getDebugLoc()) {
+				J.attribute("line", int64_t(Loc.getLine()));
+			}
+			attribute(J, "lhs", UpdateI->LHS);
+			attribute(J, "rhs", UpdateI->RHS);
+		});
+		OS << '\n';
+	}
+	if (!HasCFG) {
+		return;
+	}
+	for (Node* N : G->getAbstractedNodes()) {
+		for (Node* S : N->getSucc()) {
+			json::OStream J(OS);
+			J.object([&] {
+				writeHeader(J, "edge", F);
+				J.attribute("from", int64_t(N->Id));
+				J.attribute("to", int64_t(S->Id));
+				J.attribute("fromKind",
+					    NodeKindNames[N->abstractedInto]);
+				J.attribute("toKind",
+					    NodeKindNames[S->abstractedInto]);
+				if (S->abstractedInto == call) {
+					J.attribute("call",
+						    CallTypeNames[S->callType]);
+					attribute(J, "callee", S->Func);
+				}
+			});
+			OS << '\n';
+		}
+	}
+}
+
+/* writeJSONLines
+ * Functions that were not analyzed before are analyzed one at a time and
+ * released once written. In lazy mode the cfgs and the statements are reused
+ * from function to function, only the canonical expressions of the module
+ * accumulate.
+ */
+void writeJSONLines(Module& M, IRPlusPlusInfo& Info, raw_ostream& OS) {
+	TimeTraceScope Scope("writeJSONLines");
+	JSONLinesWriter Writer(M, OS);
+	for (Function& F : M) {
+		if (F.isDeclaration()) {
+			continue;
+		}
+		bool Analyzed = Info.getCFG().count(&F);
+		Writer.addFunction(F, Info);
+		if (!Analyzed) {
+			Info.release(&F);
+		}
+	}
+}
+
+bool writeFile(StringRef Path, size_t Size,
+	       function_ref<void(raw_ostream&)> Write) {
+	std::error_code EC;
+	raw_fd_ostream OS(Path, EC, sys::fs::OF_None);
+	if (!EC) {
+		OS.SetBufferSize(Size);
+		Write(OS);
+		OS.flush();
+		EC = OS.error();
+	}
+	if (EC) {
+		errs() << "llvmir++: can not write " << Path << ": "
+		       << EC.message() << "\n";
+		OS.clear_error();
+		return false;
+	}
+	return true;
+}
+
+bool writeResults(Module& M, IRPlusPlusInfo& Info, StringRef Path) {
+	return writeFile(Path, 1 << 16, [&](raw_ostream& OS) {
+		writeResults(M, Info, OS);
+	});
+}
+
+bool writeJSONLines(Module& M, IRPlusPlusInfo& Info, StringRef Path) {
+	return writeFile(Path, 1 << 16, [&](raw_ostream& OS) {
+		writeJSONLines(M, Info, OS);
+	});
+}
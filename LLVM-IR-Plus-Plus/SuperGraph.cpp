@@ -0,0 +1,116 @@
+#include "include/SuperGraph.h"
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/Support/TimeProfiler.h"
+
+using namespace llvm;
+
+/* Constructor for ModuleCallGraph
+ * Generates the cfg of every function not analyzed yet
+ */
+ModuleCallGraph::ModuleCallGraph(Module& M, IRPlusPlusInfo& Info,
+				 VirtualCallResolver* Resolver) {
+	TimeTraceScope Scope("ModuleCallGraph");
+	Vertices.emplace_back(nullptr);
+	Root = &Vertices.back();
+	for (Function& F : M) {
+		Vertices.emplace_back(&F);
+		FunctionVertices[&F] = &Vertices.back();
+		Root->Callees.push_back(&Vertices.back());
+		if (!F.isDeclaration() && F.hasAddressTaken()) {
+			AddressTaken[F.getFunctionType()].push_back(&F);
+		}
+	}
+	for (Function& F : M) {
+		CFG* G = Info.getCFG(&F);
+		if (!G || !G->getStartNode()) {
+			continue;
+		}
+		CallGraphVertex* V = FunctionVertices[&F];
+		SmallPtrSet<CallGraphVertex*, 8> Seen;
+		for (Node* N : G->getAbstractedNodes()) {
+			if (N->abstractedInto != call || N->callType == intrinsic) {
+				continue;
+			}
+			ArrayRef<Function*> Targets;
+			if (N->callType == direct) {
+				// The callee of the vertex lives as long as the
+				// call graph, unlike the node of the cfg
+				if (CallGraphVertex* CV =
+					FunctionVertices.lookup(N->Func)) {
+					Targets = CV->F;
+				}
+			} else if (N->callType == virt) {
+				if (Resolver) {
+					Targets = Resolver->getTargets(N);
+				}
+			} else {
+				auto It = AddressTaken.find(
+				    cast<CallInst>(N->Inst)->getFunctionType());
+				if (It != AddressTaken.end()) {
+					Targets = It->second;
+				}
+			}
+			V->CallNodes.push_back(N);
+			CallTargets[N] = Targets;
+			for (Function* Callee : Targets) {
+				CallGraphVertex* CV = FunctionVertices[Callee];
+				if (Seen.insert(CV).second) {
+					V->Callees.push_back(CV);
+				}
+			}
+		}
+	}
+}
+
+std::vector<std::vector<Function*>> ModuleCallGraph::getBottomUpSCCs() {
+	std::vector<std::vector<Function*>> SCCs;
+	for (auto I = scc_begin(this); !I.isAtEnd(); ++I) {
+		std::vector<Function*> SCC;
+		for (CallGraphVertex* V : *I) {
+			if (V->F) {
+				SCC.push_back(V->F);
+			}
+		}
+		if (!SCC.empty()) {
+			SCCs.push_back(std::move(SCC));
+		}
+	}
+	return SCCs;
+}
+
+SuperGraph::SuperGraph(ModuleCallGraph& CG, IRPlusPlusInfo& Info)
+    : CallGraph(CG) {
+	TimeTraceScope Scope("SuperGraph");
+	for (CallGraphVertex* V : CG.getRoot()->Callees) {
+		for (Node* Call : V->CallNodes) {
+			CallEdges& Edges = Calls[Call];
+			for (Function* Callee : CG.getCallees(Call)) {
+				CFG* G = Info.getCFG(Callee);
+				if (!G || !G->getStartNode()) {
+					continue;
+				}
+				Edges.Entries.push_back(G->getStartNode());
+				Edges.Exits.push_back(G->getEndNode());
+				CallSites[Callee].push_back(Call);
+			}
+		}
+	}
+}
+
+ArrayRef<Node*> SuperGraph::getCalleeEntries(const Node* Call) const {
+	auto It = Calls.find(Call);
+	return It == Calls.end() ? ArrayRef<Node*>()
+				   : ArrayRef<Node*>(It->second.Entries);
+}
+
+ArrayRef<Node*> SuperGraph::getCalleeExits(const Node* Call) const {
+	auto It = Calls.find(Call);
+	return It == Calls.end() ? ArrayRef<Node*>()
+				   : ArrayRef<Node*>(It->second.Exits);
+}
+
+ArrayRef<Node*> SuperGraph::getCallSites(Function* F) const {
+	auto It = CallSites.find(F);
+	return It == CallSites.end() ? ArrayRef<Node*>()
+				       : ArrayRef<Node*>(It->second);
+}
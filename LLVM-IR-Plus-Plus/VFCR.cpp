@@ -0,0 +1,253 @@
+#include "include/VFCR.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/Support/TimeProfiler.h"
+
+using namespace llvm;
+
+const unsigned VirtualCallResolver::NoClass;
+
+/* Constructor for VirtualCallResolver
+ * Reads every vtable and typeinfo of the module once
+ */
+VirtualCallResolver::VirtualCallResolver(Module& M) {
+	TimeTraceScope Scope("VirtualCallResolver");
+	for (GlobalVariable& GV : M.globals()) {
+		if (!GV.hasInitializer()) {
+			continue;
+		}
+		if (GV.getName().startswith("_ZTV")) {
+			readVTable(&GV);
+		} else if (GV.getName().startswith("_ZTI")) {
+			readTypeInfo(&GV);
+		}
+	}
+}
+
+unsigned VirtualCallResolver::getClass(StringRef MangledName) {
+	auto Inserted = ClassIds.insert({MangledName, Classes.size()});
+	if (Inserted.second) {
+		Classes.emplace_back();
+	}
+	return Inserted.first->second;
+}
+
+/* readVTable
+ * The primary vtable is the first array of the initializer. Its address
+ * point follows the offset to top and the typeinfo, ie the first entry after
+ * the _ZTI reference or entry 2 when compiled without RTTI.
+ */
+void VirtualCallResolver::readVTable(GlobalVariable* GV) {
+	Constant* Init = GV->getInitializer();
+	if (isa<ConstantStruct>(Init)) {
+		Init = Init->getAggregateElement(0u);
+	}
+	ConstantArray* VTable = dyn_cast_or_null<ConstantArray>(Init);
+	if (!VTable) {
+		return;
+	}
+	unsigned AddressPoint = 2;
+	for (unsigned I = 0; I < VTable->getNumOperands(); I++) {
+		Value* Entry = VTable->getOperand(I)->stripPointerCasts();
+		if (Entry->getName().startswith("_ZTI")) {
+			AddressPoint = I + 1;
+			break;
+		}
+	}
+	ClassInfo& Class = Classes[getClass(GV->getName().drop_front(4))];
+	for (unsigned I = AddressPoint; I < VTable->getNumOperands(); I++) {
+		Function* F = dyn_cast<Function>(
+		    VTable->getOperand(I)->stripPointerCasts());
+		if (F && F->getName() == "__cxa_pure_virtual") {
+			F = nullptr;
+		}
+		Class.Slots.push_back(F);
+	}
+}
+
+/* readTypeInfo
+ * __si_class_type_info has the typeinfo of its base after the name and
+ * __vmi_class_type_info a list of base typeinfos and offsets after the flags
+ * and the number of bases, so every _ZTI reference after the name is a base
+ */
+void VirtualCallResolver::readTypeInfo(GlobalVariable* GV) {
+	ConstantStruct* TypeInfo = dyn_cast<ConstantStruct>(GV->getInitializer());
+	if (!TypeInfo) {
+		return;
+	}
+	unsigned Derived = getClass(GV->getName().drop_front(4));
+	for (unsigned I = 2; I < TypeInfo->getNumOperands(); I++) {
+		Value* Op = TypeInfo->getOperand(I)->stripPointerCasts();
+		if (!isa<GlobalVariable>(Op) || !Op->getName().startswith("_ZTI")) {
+			continue;
+		}
+		unsigned Base = getClass(Op->getName().drop_front(4));
+		Classes[Derived].Bases.push_back(Base);
+		Classes[Base].Derived.push_back(Derived);
+	}
+}
+
+/* getClass
+ * Mangles the name of the struct type of the receiver, eg class.A is 1A and
+ * struct.ns::A is N2ns1AE. Templates are not mangled and left unknown.
+ */
+unsigned VirtualCallResolver::getClass(Type* ReceiverTy) {
+	PointerType* PtrTy = dyn_cast<PointerType>(ReceiverTy);
+	if (!PtrTy || PtrTy->isOpaque()) {
+		return NoClass;
+	}
+	StructType* STy =
+	    dyn_cast<StructType>(PtrTy->getPointerElementType());
+	if (!STy || !STy->hasName()) {
+		return NoClass;
+	}
+	auto It = TypeClasses.find(STy);
+	if (It != TypeClasses.end()) {
+		return It->second;
+	}
+	StringRef Name = STy->getName();
+	Name = Name.substr(Name.find('.') + 1);
+	// Drop the suffixes of renamed and base subobject types
+	Name.consume_back(".base");
+	StringRef Suffix = Name.substr(Name.rfind('.') + 1);
+	if (Name.contains('.') && !Suffix.empty() &&
+	    all_of(Suffix, [](char C) { return isdigit(C); })) {
+		Name = Name.drop_back(Suffix.size() + 1);
+	}
+	unsigned Class = NoClass;
+	if (!Name.contains('<')) {
+		SmallVector<StringRef, 4> Parts;
+		Name.split(Parts, "::");
+		std::string Mangled;
+		for (StringRef Part : Parts) {
+			if (Part == "(anonymous namespace)") {
+				Part = "_GLOBAL__N_1";
+			}
+			Mangled += std::to_string(Part.size()) + Part.str();
+		}
+		if (Parts.size() > 1) {
+			Mangled = "N" + Mangled + "E";
+		}
+		auto Id = ClassIds.find(Mangled);
+		if (Id != ClassIds.end()) {
+			Class = Id->second;
+		}
+	}
+	TypeClasses[STy] = Class;
+	return Class;
+}
+
+/* getSlot
+ * The callee is loaded from a constant index of the vtable, see isVirtualCall.
+ * Slot 0 is loaded through a GEP as well, a callee loaded from the vtable
+ * pointer itself is not a virtual call for isVirtualCall.
+ */
+bool VirtualCallResolver::getSlot(const CallInst* CI, unsigned& Slot) {
+	LoadInst* VirtFunc = dyn_cast<LoadInst>(CI->getCalledOperand());
+	if (!VirtFunc) {
+		return false;
+	}
+	GetElementPtrInst* GEP =
+	    dyn_cast<GetElementPtrInst>(VirtFunc->getPointerOperand());
+	if (!GEP || GEP->getNumIndices() != 1) {
+		return false;
+	}
+	ConstantInt* Idx = dyn_cast<ConstantInt>(GEP->getOperand(1));
+	if (!Idx) {
+		return false;
+	}
+	Slot = Idx->getZExtValue();
+	return true;
+}
+
+/* resolve
+ * Collects slot Slot of the class and all classes derived from it
+ */
+ArrayRef<Function*> VirtualCallResolver::resolve(unsigned Class,
+						 unsigned Slot,
+						 FunctionType* FTy) {
+	auto Key = std::make_tuple(Class, Slot,
+				   Class == NoClass ? FTy : nullptr);
+	auto It = SlotTargets.find(Key);
+	if (It != SlotTargets.end()) {
+		return It->second;
+	}
+	std::vector<Function*>& Targets = SlotTargets[Key];
+	SmallPtrSet<Function*, 8> Seen;
+	auto AddSlot = [&](ClassInfo& Info) {
+		if (Slot >= Info.Slots.size()) {
+			return;
+		}
+		Function* F = Info.Slots[Slot];
+		if (F && (Class != NoClass || F->getFunctionType() == FTy) &&
+		    Seen.insert(F).second) {
+			Targets.push_back(F);
+		}
+	};
+	if (Class == NoClass) {
+		for (ClassInfo& Info : Classes) {
+			AddSlot(Info);
+		}
+		return Targets;
+	}
+	std::vector<unsigned> WorkList{Class};
+	DenseSet<unsigned> Visited{Class};
+	while (!WorkList.empty()) {
+		ClassInfo& Info = Classes[WorkList.back()];
+		WorkList.pop_back();
+		AddSlot(Info);
+		for (unsigned D : Info.Derived) {
+			if (Visited.insert(D).second) {
+				WorkList.push_back(D);
+			}
+		}
+	}
+	return Targets;
+}
+
+ArrayRef<Function*> VirtualCallResolver::getTargets(const CallInst* CI) {
+	auto It = CallTargets.find(CI);
+	if (It != CallTargets.end()) {
+		return It->second;
+	}
+	ArrayRef<Function*> Targets;
+	unsigned Slot;
+	if (isVirtualCall(const_cast<CallInst*>(CI)) && getSlot(CI, Slot)) {
+		unsigned Class = getClass(CI->getArgOperand(0)->getType());
+		Targets = resolve(Class, Slot, CI->getFunctionType());
+	}
+	CallTargets[CI] = Targets;
+	return Targets;
+}
+
+ArrayRef<Function*> VirtualCallResolver::getTargets(const Node* N) {
+	if (N->abstractedInto != call || N->callType != virt) {
+		return None;
+	}
+	return getTargets(cast<CallInst>(N->Inst));
+}
+
+PreservedAnalyses VFCRPrinterPass::run(Module& M, ModuleAnalysisManager&) {
+	VirtualCallResolver Resolver(M);
+	for (Function& F : M) {
+		bool First = true;
+		for (Instruction& I : instructions(F)) {
+			CallInst* CI = dyn_cast<CallInst>(&I);
+			unsigned Slot;
+			if (!CI || !isVirtualCall(CI) ||
+			    !VirtualCallResolver::getSlot(CI, Slot)) {
+				continue;
+			}
+			if (First) {
+				OS << "Virtual calls of " << F.getName() << ":\n";
+				First = false;
+			}
+			OS << *CI << "\n    slot: " << Slot << "\n    targets:";
+			for (Function* Target : Resolver.getTargets(CI)) {
+				OS << " ";
+				Target->printAsOperand(OS, false);
+			}
+			OS << "\n";
+		}
+	}
+	return PreservedAnalyses::all();
+}
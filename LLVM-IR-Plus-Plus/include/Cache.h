@@ -0,0 +1,54 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "LLVMIR++.h"
+#include "llvm/Support/MD5.h"
+
+/* FunctionSummary
+ * Cached results of one function. Key is the hash of the function, Found is
+ * set when MetaData and Shape were read from the cache. Buffer holds the
+ * encoded metadata of a function that is not cached yet.
+ */
+class FunctionSummary {
+       public:
+	MD5::MD5Result Key;
+	bool Found = false;
+	FunctionMetaData MetaData;
+	CFGShape Shape;
+	std::string Buffer;
+};
+
+/* SummaryCache
+ * Persistent cache of the raw metadata and the cfg shape of functions, one
+ * file per function in a directory, named after the hash of the function.
+ *
+ * The hash covers the instructions, their operands and types, the types of
+ * the function including the bodies of the named structs they refer to and
+ * the names of the referenced globals, but not the name of the function
+ * itself. Values are stored as the index of the instruction or argument in
+ * the function, the name of the global or the instruction operand holding
+ * the constant, a function referring to anything else eg an unnamed global
+ * is not cached.
+ *
+ * Functions are hashed, loaded and stored independently of each other, the
+ * cache can be used by the threads of IRPlusPlusInfo::analyze.
+ */
+class SummaryCache {
+	std::string Dir;
+	std::string getPath(const MD5::MD5Result&) const;
+
+       public:
+	explicit SummaryCache(StringRef Dir);
+	// Hashes F and reads its summary if it is cached
+	std::unique_ptr<FunctionSummary> lookup(Function&);
+	// Encodes the raw metadata of a function missing from the cache into
+	// its summary, returns false if the function can not be cached
+	bool encode(Function&, const FunctionMetaData&, FunctionSummary&);
+	// Writes the summary and the shape of the cfg of an encoded function
+	void store(FunctionSummary&, const CFG&);
+};
+
+#endif
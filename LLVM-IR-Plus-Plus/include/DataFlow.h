@@ -0,0 +1,238 @@
+#ifndef DATAFLOW_H
+#define DATAFLOW_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "LLVMIR++.h"
+
+/* Monotone dataflow framework over the abstracted CFG
+ *
+ * A problem gives the direction, the meet operator, the number of facts and
+ * either gen/kill sets or its own transfer function for every node. The
+ * solver keeps IN and OUT of every node of the abstracted cfg as packed
+ * bit-vectors and iterates a worklist ordered by reverse post order until a
+ * fixpoint is reached.
+ *
+ * IN is the program point before a node and OUT the one after it for both
+ * directions. A forward problem computes OUT from IN, a backward problem
+ * computes IN from OUT.
+ */
+
+/* BitSetRef
+ * View of a packed bit-vector, bit i is bit i % 64 of word i / 64. The words
+ * are owned by the solver.
+ */
+class BitSetRef {
+	uint64_t* Words;
+	unsigned NumWords;
+
+       public:
+	BitSetRef(uint64_t* Words, unsigned NumWords)
+	    : Words(Words), NumWords(NumWords) {}
+	bool test(unsigned Bit) const {
+		return Words[Bit / 64] & (uint64_t(1) << (Bit % 64));
+	}
+	void set(unsigned Bit) { Words[Bit / 64] |= uint64_t(1) << (Bit % 64); }
+	void reset(unsigned Bit) {
+		Words[Bit / 64] &= ~(uint64_t(1) << (Bit % 64));
+	}
+	// Number of set bits
+	unsigned count() const;
+	// Calls Fn with every set bit in increasing order
+	template <typename FnT>
+	void forEach(FnT Fn) const {
+		for (unsigned W = 0; W < NumWords; W++) {
+			for (uint64_t Word = Words[W]; Word; Word &= Word - 1) {
+				Fn(W * 64 + countTrailingZeros(Word));
+			}
+		}
+	}
+	uint64_t* data() const { return Words; }
+	unsigned getNumWords() const { return NumWords; }
+};
+
+/* Word loops over packed bit-vectors of N words. The kernels returning a bool
+ * report whether Dst changed.
+ */
+namespace bitset {
+// Dst = Dst | Src
+bool unionWith(uint64_t* Dst, const uint64_t* Src, unsigned N);
+// Dst = Dst & Src
+bool intersectWith(uint64_t* Dst, const uint64_t* Src, unsigned N);
+// Dst = Dst & ~Src
+void subtract(uint64_t* Dst, const uint64_t* Src, unsigned N);
+bool equals(const uint64_t* A, const uint64_t* B, unsigned N);
+// Dst = Gen | (Src & ~Kill)
+bool transfer(uint64_t* Dst, const uint64_t* Src, const uint64_t* Gen,
+	      const uint64_t* Kill, unsigned N);
+}  // namespace bitset
+
+enum FlowDirection { forward, backward };
+
+enum MeetOperator { meetUnion, meetIntersection };
+
+/* DataFlowProblem
+ * Client side of the framework. Problems that are not expressible with gen
+ * and kill sets override transfer and return false from usesGenKill.
+ */
+class DataFlowProblem {
+       public:
+	FlowDirection Direction;
+	MeetOperator Meet;
+	// Number of facts ie bits in every set
+	unsigned NumBits;
+	DataFlowProblem(FlowDirection Direction, MeetOperator Meet,
+			unsigned NumBits)
+	    : Direction(Direction), Meet(Meet), NumBits(NumBits) {}
+	virtual ~DataFlowProblem() = default;
+	// Value at the entry node of a forward problem or the exit node of a
+	// backward problem, empty by default
+	virtual void initBoundary(BitSetRef) {}
+	// Gen and kill sets of a node, called once per node before solving
+	virtual void getGenKill(Node*, BitSetRef /*Gen*/,
+				BitSetRef /*Kill*/) {}
+	virtual bool usesGenKill() const { return true; }
+	// Computes Dst from Src for the node and returns true if Dst changed,
+	// used when usesGenKill returns false
+	virtual bool transfer(Node*, BitSetRef /*Src*/, BitSetRef /*Dst*/) {
+		return false;
+	}
+};
+
+/* DataFlowSolver
+ * Solves a DataFlowProblem over the abstracted cfg of one function. Nodes are
+ * addressed by their dense Node::Id, the sets of all nodes live in one
+ * contiguous buffer per kind.
+ */
+class DataFlowSolver {
+	CFG& G;
+	DataFlowProblem& Problem;
+	unsigned NumNodes;
+	unsigned WordsPerSet;
+	std::vector<uint64_t> InSets, OutSets, GenSets, KillSets;
+	// Reverse post order of the nodes in the direction of the problem,
+	// unreachable nodes follow in the order of their id
+	std::vector<uint32_t> Order;
+	// Number of nodes transferred until the fixpoint
+	unsigned NumVisits = 0;
+	BitSetRef getSet(std::vector<uint64_t>& Sets, uint32_t Id) {
+		return BitSetRef(Sets.data() + size_t(Id) * WordsPerSet,
+				 WordsPerSet);
+	}
+	void computeOrder(const CompactCFG&);
+	// Sets all bits below NumBits and clears the padding
+	void fill(BitSetRef);
+
+       public:
+	DataFlowSolver(CFG&, DataFlowProblem&);
+	// Iterates to the fixpoint
+	void solve();
+	BitSetRef getIn(Node* N) { return getSet(InSets, N->Id); }
+	BitSetRef getOut(Node* N) { return getSet(OutSets, N->Id); }
+	unsigned getNumVisits() const { return NumVisits; }
+};
+
+/* Variable of an expression, the alloca in base or else the global variable
+ * or function argument in functionArg, null for constants
+ */
+Value* getVariable(const Expression*);
+
+/* VariableIndex
+ * Dense numbering of the variables of a function, the bit of a variable in
+ * the sets of the analyses below
+ */
+class VariableIndex {
+	DenseMap<Value*, unsigned> Ids;
+	std::vector<Value*> Vars;
+
+       public:
+	static const unsigned NoId = ~0u;
+	unsigned insert(Value*);
+	unsigned lookup(Value* V) const {
+		auto It = Ids.find(V);
+		return It == Ids.end() ? NoId : It->second;
+	}
+	Value* getVariable(unsigned Id) const { return Vars[Id]; }
+	unsigned size() const { return Vars.size(); }
+};
+
+/* LivenessAnalysis
+ * Backward liveness of the variables over the UpdateInst statements of a
+ * function. A statement x = ... defines x, the variables read on its right
+ * hand side and the pointers dereferenced on its left hand side (*x = ... and
+ * x -> f = ...) are used. x.f = ... updates only a part of x and does not
+ * define it. The receiver of a virtual call is used by the call.
+ */
+class LivenessAnalysis : public DataFlowProblem {
+	VariableIndex Variables;
+	std::unique_ptr<DataFlowSolver> Solver;
+
+       public:
+	explicit LivenessAnalysis(CFG&);
+	void getGenKill(Node*, BitSetRef Gen, BitSetRef Kill) override;
+	const VariableIndex& getVariables() const { return Variables; }
+	BitSetRef getLiveIn(Node* N) { return Solver->getIn(N); }
+	BitSetRef getLiveOut(Node* N) { return Solver->getOut(N); }
+	bool isLiveIn(Node*, Value*);
+	bool isLiveOut(Node*, Value*);
+};
+
+/* ReachingDefinitions
+ * Forward reaching definitions over the UpdateInst statements of a function.
+ * Every statement is a definition of the variable on its left hand side, a
+ * statement x = ... kills all other definitions of x while the partial and
+ * indirect updates *x, x -> f and x.f kill nothing. The bits of the sets are
+ * the ids of the definitions.
+ */
+class ReachingDefinitions : public DataFlowProblem {
+	VariableIndex Variables;
+	// Definition nodes and the id of the definition of every such node
+	NodeList Definitions;
+	DenseMap<Node*, unsigned> DefIds;
+	// Definitions of every variable, one packed set per variable
+	std::vector<uint64_t> DefsOfVariable;
+	unsigned WordsPerSet;
+	std::unique_ptr<DataFlowSolver> Solver;
+
+       public:
+	explicit ReachingDefinitions(CFG&);
+	void getGenKill(Node*, BitSetRef Gen, BitSetRef Kill) override;
+	const VariableIndex& getVariables() const { return Variables; }
+	Node* getDefinition(unsigned Id) const { return Definitions[Id]; }
+	unsigned getNumDefinitions() const { return Definitions.size(); }
+	BitSetRef getReachingIn(Node* N) { return Solver->getIn(N); }
+	BitSetRef getReachingOut(Node* N) { return Solver->getOut(N); }
+	// Calls Fn with every definition of V reaching the point before N
+	template <typename FnT>
+	void forEachReachingDef(Node* N, Value* V, FnT Fn) {
+		unsigned Var = Variables.lookup(V);
+		if (Var == VariableIndex::NoId) {
+			return;
+		}
+		BitSetRef In = getReachingIn(N);
+		const uint64_t* Defs =
+		    DefsOfVariable.data() + size_t(Var) * WordsPerSet;
+		for (unsigned W = 0; W < WordsPerSet; W++) {
+			for (uint64_t Word = In.data()[W] & Defs[W]; Word;
+			     Word &= Word - 1) {
+				Fn(Definitions[W * 64 + countTrailingZeros(Word)]);
+			}
+		}
+	}
+};
+
+/* DataFlowPrinterPass
+ * Prints the live variables and the reaching definitions before and after
+ * every node of the abstracted cfgs, -passes='print<llvmir++-dataflow>'.
+ * Definitions are printed as the ids of their nodes.
+ */
+class DataFlowPrinterPass : public PassInfoMixin<DataFlowPrinterPass> {
+	raw_ostream& OS;
+
+       public:
+	explicit DataFlowPrinterPass(raw_ostream& OS) : OS(OS) {}
+	PreservedAnalyses run(Module&, ModuleAnalysisManager&);
+};
+
+#endif
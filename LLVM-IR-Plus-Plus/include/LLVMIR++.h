@@ -3,14 +3,19 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <iterator>
+#include <map>
 #include <memory>
+#include <type_traits>
 #include <unordered_set>
 #include <utility>
 #include <vector>
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/Statistic.h"
@@ -29,10 +34,13 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
 #include "llvm/IR/Use.h"
 #include "llvm/IR/User.h"
 #include "llvm/IR/Value.h"
+#include "llvm/IR/ValueHandle.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/Allocator.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
@@ -44,6 +52,27 @@ using namespace llvm;
 
 enum SymbolType { simple, pointer, arrow, dot, constant, address , newObj};
 
+/* Arena
+ * Bump allocator for the objects built while abstracting the IR. Objects are
+ * never freed one at a time, reset() releases all of them together.
+ */
+class Arena {
+       private:
+	BumpPtrAllocator Allocator;
+
+       public:
+	// Allocates a T constructed from Args, T must not need a destructor
+	template <typename T, typename... ArgTs>
+	T* create(ArgTs&&... Args) {
+		static_assert(std::is_trivially_destructible<T>::value,
+			      "Arena never runs destructors");
+		return new (Allocator.Allocate<T>())
+		    T(std::forward<ArgTs>(Args)...);
+	}
+	// Frees every object allocated so far
+	void reset() { Allocator.Reset(); }
+};
+
 /* Statement 	:= LHS = RHS
  * LHS		:= x | *x | x -> f | x.f
  * RHS		:= y | *y | y -> f | y.f | &y
@@ -95,10 +124,65 @@ class Expression {
 	Expression();
 	Expression(const Expression*);
 	void print();
+	// Expressions returned by an ExpressionPool are canonical and can also
+	// be compared by pointer
 	class ExpEqual {
 	       public:
 		bool operator()(Expression const*, Expression const*) const;
 	};
+	class ExpHash {
+	       public:
+		size_t operator()(Expression const*) const;
+	};
+};
+
+/* FieldIndex
+ * Canonicalizes field accesses. GEPs with the same source element type and
+ * the same index list address the same field, the first GEP seen for a field
+ * path stands for all of them. GEPs are bucketed on the hash of their field
+ * path so a lookup only compares GEPs of the same bucket. GEPs are held by
+ * weak handles, a deleted GEP drops out of its bucket.
+ */
+class FieldIndex {
+       private:
+	DenseMap<unsigned, SmallVector<WeakVH, 1>> Buckets;
+
+       public:
+	// Returns the canonical GEP for the field path of Inst
+	Instruction* handleGEP(GetElementPtrInst* Inst);
+	void clear() { Buckets.clear(); }
+};
+
+/* ExpressionPool
+ * Hash conses expressions. There is exactly one canonical Expression for every
+ * distinct base, optional, type, symbol, functionArg and RHSisAddress, hence
+ * two canonical expressions are equal iff they are the same pointer.
+ * Field accesses in optional are canonicalized through the pool's FieldIndex
+ * before interning. Canonical expressions are shared and must not be modified.
+ */
+class ExpressionPool {
+       private:
+	struct ExpInfo {
+		static Expression* getEmptyKey();
+		static Expression* getTombstoneKey();
+		static unsigned getHashValue(const Expression*);
+		static bool isEqual(const Expression*, const Expression*);
+	};
+	DenseSet<Expression*, ExpInfo> Pool;
+	// Canonical field accesses of the module
+	FieldIndex Fields;
+	// Canonical expressions are allocated here
+	Arena& Allocator;
+
+       public:
+	ExpressionPool(Arena&);
+	// Returns the canonical expression structurally equal to Exp
+	Expression* intern(Expression Exp);
+	size_t size() const { return Pool.size(); }
+	void clear() {
+		Pool.clear();
+		Fields.clear();
+	}
 };
 
 /* LHSExpression
@@ -116,24 +200,96 @@ class LHSExpression : public Expression {
  * ... = RHS
  */
 class RHSExpression : public Expression {
+	// Operators whose operands were walked already
+	SmallPtrSet<Value*, 4> Visited;
+
        public:
 	RHSExpression(Value*);
 	void getMetaData(Value*);
 };
 
+/* RawUpdateInst
+ * Store assignment LHS = RHS before the expressions are interned. Building it
+ * only reads the IR, hence the raw assignments of different functions can be
+ * built concurrently.
+ */
+class RawUpdateInst {
+       public:
+	StoreInst* Inst;
+	Expression LHS, RHS;
+	RawUpdateInst() = default;
+	RawUpdateInst(StoreInst* I);
+};
+
 /* UpdateInst
  * Store assignment
  * LHS = RHS
  */
 class UpdateInst {
        public:
+	// Store instruction the assignment is abstracted from
+	StoreInst* Inst;
 	Expression *LHS, *RHS;
-	UpdateInst(StoreInst* I);
+	// LHS and RHS are canonical expressions of the given pool
+	UpdateInst(StoreInst* I, ExpressionPool&);
+	UpdateInst(const RawUpdateInst&, ExpressionPool&);
 	void print();
 };
 
-/* Maps store instruction to the meta data */
-using InstMetaMap = std::map<StoreInst*, UpdateInst*>;
+/* FunctionMetaData
+ * Raw meta data of one function: its store assignments and the receivers of
+ * its virtual calls, in the order of the instructions
+ */
+class FunctionMetaData {
+       public:
+	std::vector<RawUpdateInst> Updates;
+	std::vector<std::pair<CallInst*, Expression>> Receivers;
+	FunctionMetaData() = default;
+	FunctionMetaData(Function&);
+};
+
+// Returns true if the call matches the pattern of a virtual call ie the
+// called function is loaded from a slot of a loaded vtable
+bool isVirtualCall(CallInst*);
+
+// Follows loads and bitcasts back to the instruction a pointer is based on
+Instruction* resolveBase(Instruction*);
+
+/* MetaDataStore
+ * Module level store of the generated meta data. Every store instruction is
+ * given a dense index into Updates, lookups are O(1) and the CFG nodes borrow
+ * the UpdateInst from here instead of copying the whole map.
+ */
+class MetaDataStore {
+       private:
+	// Dense index of every store instruction with meta data
+	DenseMap<StoreInst*, unsigned> Index;
+	// Meta data in the order the stores were added
+	std::vector<UpdateInst*> Updates;
+	// Receiver object of every virtual call
+	DenseMap<CallInst*, Expression*> Receivers;
+
+       public:
+	using iterator = std::vector<UpdateInst*>::const_iterator;
+	// Adds or replaces the meta data of a store instruction
+	void insert(UpdateInst*);
+	// Returns the meta data of the store instruction or null
+	UpdateInst* lookup(StoreInst*) const;
+	// Drops the meta data of a store instruction and returns it, null if
+	// the store had none
+	UpdateInst* erase(StoreInst*);
+	// Adds the canonical receiver expression of a virtual call
+	void insertReceiver(CallInst*, Expression*);
+	// Drops the receiver of a virtual call
+	void eraseReceiver(CallInst*);
+	// Returns the receiver of the virtual call or null
+	Expression* lookupReceiver(CallInst*) const;
+	iterator begin() const { return Updates.begin(); }
+	iterator end() const { return Updates.end(); }
+	size_t size() const { return Updates.size(); }
+	void clear();
+};
+
 class Node;
 using NodeList = std::vector<Node*>;
 
@@ -157,6 +313,13 @@ class Node {
 	int loc;
 	// list of succsessors and predesessors
 	NodeList Succ, Pred;
+	// successors and predecessors in the abstracted CFG, filled once by
+	// CFG::init
+	NodeList AbsSucc, AbsPred;
+	// Dense id of the node in the abstracted CFG, the entry node is 0 and
+	// the exit node is the last one. Unabstracted nodes have NoId
+	uint32_t Id;
+	static const uint32_t NoId = ~0u;
 	CallType callType;
 	Function* Func;
 	Expression* Callee;
@@ -164,23 +327,76 @@ class Node {
 	void resetNode();
 
 	// Returns the successors from the abstracted CFG
-	NodeList getSucc();
+	const NodeList& getSucc() const;
 
 	// Returns the predecessors from the abstracted CFG
-	NodeList getPred();
+	const NodeList& getPred() const;
 
 	// returns both abstracted and unabstracted successor nodes
-	NodeList getRealSucc();
+	const NodeList& getRealSucc() const;
 
 	// returns both abstracted and unabstracted predecessor nodes
-	NodeList getRealPred();
+	const NodeList& getRealPred() const;
 
 	// Print node
 	void print();
 
 	Node();
 
-	Node(Instruction*, InstMetaMap);
+	// The node only reads the meta data, nodes of different functions can
+	// be built concurrently
+	Node(Instruction*, const MetaDataStore&);
+};
+
+class CFG;
+
+/* CompactCFG
+ * Compressed sparse row layout of the abstracted CFG of a function. Nodes are
+ * identified by their dense Node::Id, the successors of node i are
+ * SuccEdges[SuccOffsets[i] .. SuccOffsets[i + 1]) and likewise for the
+ * predecessors. The node payload is kept in parallel arrays indexed by id.
+ */
+class CompactCFG {
+       public:
+	using NodeId = uint32_t;
+
+       private:
+	std::vector<uint32_t> SuccOffsets, PredOffsets;
+	std::vector<NodeId> SuccEdges, PredEdges;
+	std::vector<Instruction*> Insts;
+	std::vector<Expression*> LHSs, RHSs;
+	std::vector<InstType> Kinds;
+
+       public:
+	CompactCFG(const CFG&);
+	// Number of nodes in the abstracted CFG
+	uint32_t size() const { return Insts.size(); }
+	NodeId getStart() const { return 0; }
+	NodeId getEnd() const { return size() - 1; }
+	ArrayRef<NodeId> getSucc(NodeId N) const {
+		return makeArrayRef(SuccEdges.data() + SuccOffsets[N],
+				    SuccEdges.data() + SuccOffsets[N + 1]);
+	}
+	ArrayRef<NodeId> getPred(NodeId N) const {
+		return makeArrayRef(PredEdges.data() + PredOffsets[N],
+				    PredEdges.data() + PredOffsets[N + 1]);
+	}
+	// Payload of the node, Inst is null for the pseudo exit node
+	Instruction* getInst(NodeId N) const { return Insts[N]; }
+	Expression* getLHS(NodeId N) const { return LHSs[N]; }
+	Expression* getRHS(NodeId N) const { return RHSs[N]; }
+	InstType getKind(NodeId N) const { return Kinds[N]; }
+};
+
+/* CFGShape
+ * Edges of a cfg by node index, in the order of CFG::getNodes. A cfg is
+ * rebuilt from its shape without walking the function again.
+ */
+struct CFGShape {
+	// Successors of every node including the exit node
+	std::vector<uint32_t> SuccOffsets, Succs;
+	// Node index of every abstracted node and their successors by id
+	std::vector<uint32_t> AbsNodes, AbsSuccOffsets, AbsSuccs;
 };
 
 class CFG {
@@ -189,12 +405,33 @@ class CFG {
 	Node* StartNode;
 	// Unique exit node for cfg
 	Node* EndNode;
+	// Index from an instruction to its unique node
+	DenseMap<Instruction*, Node*> NodeMap;
+	// Every node of the cfg in the order of the instructions, the pseudo
+	// exit node is the last one
+	NodeList Nodes;
+	// Nodes of the cfg, freed together with the cfg
+	SpecificBumpPtrAllocator<Node> NodeAllocator;
+	// Computes AbsSucc and AbsPred of the nodes in the abstracted CFG
+	void abstractEdges();
+	// Compact layout of the abstracted cfg, built on first request
+	std::unique_ptr<CompactCFG> Compact;
+	// Nodes of the abstracted cfg in the order of their id
+	NodeList AbsNodes;
 
        public:
 	// Default constructor to set entry and exit nodes as null
 	CFG();
 	// Initialize cfg for a LLVM Module
-	void init(Function*, InstMetaMap);
+	void init(Function*, const MetaDataStore&);
+	// Initialize the cfg from the shape of an earlier init of the same
+	// function, returns false and leaves the cfg empty if the shape does
+	// not fit the function
+	bool restore(Function*, const MetaDataStore&, const CFGShape&);
+	// Returns the shape of an initialized cfg
+	CFGShape getShape() const;
+	// Frees every node, the cfg can be initialized again
+	void clear();
 	// Get start and end nodes
 	Node* getStartNode(){
 		return StartNode;
@@ -203,27 +440,242 @@ class CFG {
 	Node* getEndNode(){
 		return EndNode;
 	}
+	// Returns the node created for the instruction or null
+	Node* getNode(Instruction*) const;
+	// Returns true if the node is part of the abstracted cfg
+	bool isAbstracted(const Node*) const;
+	// Returns the nodes of the abstracted cfg, indexed by Node::Id
+	const NodeList& getAbstractedNodes() const {
+		return AbsNodes;
+	}
+	// Returns the compressed sparse row layout of the abstracted cfg
+	const CompactCFG& getCompactCFG();
+	// Returns all the nodes of the cfg
+	const NodeList& getNodes() const {
+		return Nodes;
+	}
 };
 
 using FunctionToCFG = std::map<Function*, CFG*>;
 
-class LLVMIRPlusPlusPass : public ModulePass {
+class IRPlusPlusInfo;
+class SummaryCache;
+
+/* DependencyVH
+ * Watches a value the metadata or the cfg of a function depends on. When the
+ * value is deleted or replaced the function is invalidated.
+ */
+class DependencyVH final : public CallbackVH {
+	IRPlusPlusInfo* Info;
+	Function* F;
+	void deleted() override;
+	void allUsesReplacedWith(Value*) override;
+
+       public:
+	DependencyVH(Value* V, IRPlusPlusInfo* Info, Function* F)
+	    : CallbackVH(V), Info(Info), F(F) {}
+};
+
+/* IRPlusPlusInfo
+ * Metadata and cfgs generated for a module or for a single function. It owns
+ * every Expression, UpdateInst, Node and CFG it hands out, they live until
+ * clear() or until the object is destroyed. The legacy pass and the new pass
+ * manager analyses are thin wrappers around it.
+ */
+class IRPlusPlusInfo {
        public:
 	// grcfg is the abstracted cfg
 	FunctionToCFG grcfg;
-	InstMetaMap IRPlusPlus;
+	MetaDataStore IRPlusPlus;
+	IRPlusPlusInfo();
+	IRPlusPlusInfo(const IRPlusPlusInfo&) = delete;
+	IRPlusPlusInfo& operator=(const IRPlusPlusInfo&) = delete;
+	// generates metadata and cfg of every function with a body in the
+	// module that is not analyzed yet, the functions are processed by
+	// NumThreads threads (0 uses all the hardware threads)
+	void analyze(Module&, unsigned NumThreads = 1);
+	// generates metadata and cfg of the functions with a body that are not
+	// analyzed yet, eg the functions materialized from a lazily loaded
+	// module
+	void analyze(ArrayRef<Function*>, unsigned NumThreads = 1);
+	// generates metadata and cfg of a single function
+	void analyze(Function&);
+	// force generate metadata for one store instruction
+	void generateMetaData(StoreInst*);
+	// prints expression
+	void printExp(Expression*);
+	// returns generated metadata
+	const MetaDataStore& getIRPlusPlus() const { return IRPlusPlus; }
+	// returns the abstracted cfgs built so far
+	const FunctionToCFG& getCFG() const { return grcfg; }
+	// returns the abstracted cfg of the function, it is built on the first
+	// request. Declarations have no cfg and return null
+	CFG* getCFG(Function*);
+	// returns the metadata of the store instruction, it is generated on
+	// the first request
+	UpdateInst* getMetaData(StoreInst*);
+	// frees the metadata and every cfg
+	void clear();
+	// With change tracking every analyzed function is watched through value
+	// handles. Deleting or replacing one of its instructions or a value its
+	// metadata refers to invalidates the function. Transforms that only
+	// insert or rewrite instructions must call invalidate themselves.
+	void setTrackChanges(bool Track) { TrackChanges = Track; }
+	// Functions found in the cache are restored from it instead of being
+	// analyzed, analyzed functions are added to it
+	void setCache(std::shared_ptr<SummaryCache> C) { Cache = std::move(C); }
+	// drops the metadata and the cfg of a modified function, update()
+	// rebuilds them. A deleted function is dropped for good
+	void invalidate(Function*, bool Deleted = false);
+	// drops the metadata and the cfg of a function that is not needed any
+	// more, its cfg and statements are reused by the next analyzed
+	// function. The canonical expressions stay until clear()
+	void release(Function*);
+	// rebuilds the metadata and the cfg of every invalidated function
+	void update();
+	// returns the functions invalidated since the last update
+	ArrayRef<Function*> getDirtyFunctions() const {
+		return Dirty.getArrayRef();
+	}
+
+       private:
+	// Owns every Expression and UpdateInst of the metadata
+	Arena IRArena;
+	// Canonical expressions of the module
+	ExpressionPool Expressions;
+	// Owns every cfg in grcfg
+	SpecificBumpPtrAllocator<CFG> CFGAllocator;
+	// Interns the raw meta data of a function into IRPlusPlus
+	void commitMetaData(FunctionMetaData&);
+	// Interns one raw store assignment into IRPlusPlus
+	void commitMetaData(const RawUpdateInst&);
+	std::shared_ptr<SummaryCache> Cache;
+	// Allocates an empty cfg for the function and registers it in grcfg
+	CFG* createCFG(Function*);
+	// Cfgs of invalidated functions, reused by createCFG
+	std::vector<CFG*> FreeCFGs;
+	// Statements of released functions, reused by commitMetaData
+	std::vector<UpdateInst*> FreeUpdates;
+	// Drops the metadata and the cfg of the function
+	void drop(Function*);
+	bool TrackChanges = false;
+	// Value handles on everything the analysis of a function depends on
+	DenseMap<Function*, std::vector<DependencyVH>> Dependencies;
+	// Invalidated functions in the order they were invalidated
+	SetVector<Function*> Dirty;
+	// Functions whose stores and calls were counted in the statistics
+	DenseSet<Function*> Counted;
+	// Registers the value handles of an analyzed function
+	void watch(Function*);
+};
+
+// Sets up change tracking and the summary cache of the info as requested by
+// the -llvmir++-* command line options
+void applyCommandLineOptions(IRPlusPlusInfo&);
+// Number of threads requested by -llvmir++-threads, 0 is all the hardware
+// threads
+unsigned getNumThreadsOption();
+// Runs Body(0) .. Body(N - 1) on NumThreads threads, the indices are handed
+// out one at a time
+void parallelFor(unsigned NumThreads, size_t N,
+		 function_ref<void(size_t)> Body);
+
+/* TimeTraceSession
+ * Records a Chrome trace of the analysis into the -llvmir++-time-trace file
+ * while it is alive. When a time profiler runs already, eg opt -time-trace,
+ * the spans of the analysis go into its trace instead.
+ */
+class TimeTraceSession {
+	bool Owner = false;
+
+       public:
+	TimeTraceSession();
+	TimeTraceSession(const TimeTraceSession&) = delete;
+	TimeTraceSession& operator=(const TimeTraceSession&) = delete;
+	~TimeTraceSession();
+};
+
+class LLVMIRPlusPlusPass : public ModulePass {
+       public:
 	static char ID;
 	LLVMIRPlusPlusPass();
 	bool runOnModule(Module&) override;
+	void getAnalysisUsage(AnalysisUsage&) const override;
+	// frees the metadata and every cfg of the last module
+	void releaseMemory() override;
 	// prints expression
 	void printExp(Expression*);
 	// returns generated metadata
-	InstMetaMap getIRPlusPlus();
+	const MetaDataStore& getIRPlusPlus();
 	// returns the abstracted cfg
 	FunctionToCFG getCFG();
+	// returns the abstracted cfg of one function, built on demand
+	CFG* getCFG(Function*);
+	// returns the metadata of one store instruction, built on demand
+	UpdateInst* getMetaData(StoreInst*);
 	// force generate metadata for one store instruction
 	void generateMetaData(StoreInst*);
-	// returns CFG
+	// returns the metadata and cfgs of the last module
+	IRPlusPlusInfo& getInfo() { return Info; }
+
+       private:
+	IRPlusPlusInfo Info;
+};
+
+/* IRPlusPlusAnalysis
+ * New pass manager module analysis, the result is cached by the analysis
+ * manager and shared by every pass of the pipeline until a pass does not
+ * preserve it
+ */
+class IRPlusPlusAnalysis : public AnalysisInfoMixin<IRPlusPlusAnalysis> {
+	friend AnalysisInfoMixin<IRPlusPlusAnalysis>;
+	static AnalysisKey Key;
+
+       public:
+	class Result {
+		std::unique_ptr<IRPlusPlusInfo> Info;
+
+	       public:
+		Result(std::unique_ptr<IRPlusPlusInfo> Info)
+		    : Info(std::move(Info)) {}
+		IRPlusPlusInfo& getInfo() const { return *Info; }
+		const MetaDataStore& getIRPlusPlus() const {
+			return Info->getIRPlusPlus();
+		}
+		const FunctionToCFG& getCFG() const { return Info->getCFG(); }
+		CFG* getCFG(Function* F) const { return Info->getCFG(F); }
+		bool invalidate(Module&, const PreservedAnalyses&,
+				ModuleAnalysisManager::Invalidator&);
+	};
+	Result run(Module&, ModuleAnalysisManager&);
+};
+
+/* IRPlusPlusFunctionAnalysis
+ * New pass manager function analysis, the metadata and the cfg of a single
+ * function. Expressions are canonical within the function only.
+ */
+class IRPlusPlusFunctionAnalysis
+    : public AnalysisInfoMixin<IRPlusPlusFunctionAnalysis> {
+	friend AnalysisInfoMixin<IRPlusPlusFunctionAnalysis>;
+	static AnalysisKey Key;
+
+       public:
+	class Result {
+		std::unique_ptr<IRPlusPlusInfo> Info;
+		Function* F;
+
+	       public:
+		Result(std::unique_ptr<IRPlusPlusInfo> Info, Function* F)
+		    : Info(std::move(Info)), F(F) {}
+		IRPlusPlusInfo& getInfo() const { return *Info; }
+		const MetaDataStore& getIRPlusPlus() const {
+			return Info->getIRPlusPlus();
+		}
+		CFG* getCFG() const { return Info->getCFG(F); }
+		bool invalidate(Function&, const PreservedAnalyses&,
+				FunctionAnalysisManager::Invalidator&);
+	};
+	Result run(Function&, FunctionAnalysisManager&);
 };
 
 #endif
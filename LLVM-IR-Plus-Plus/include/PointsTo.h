@@ -0,0 +1,140 @@
+#ifndef POINTSTO_H
+#define POINTSTO_H
+
+#include <vector>
+#include "DataFlow.h"
+#include "LLVMIR++.h"
+#include "llvm/ADT/SparseBitVector.h"
+
+/* AndersenPointsTo
+ * Whole module inclusion based points-to analysis over the UpdateInst table.
+ * Every variable (see getVariable) is a node of the constraint graph and an
+ * abstract object whose address can be taken, every statement with a newObj
+ * RHS adds a heap object named by its store. The statement forms map to the
+ * constraints
+ *
+ *	x = &y		address	y in pts(x)
+ *	x = new		address	heap in pts(x)
+ *	x = y		copy	pts(y) <= pts(x)
+ *	x = *y		load	pts(o) <= pts(x) for o in pts(y)
+ *	*x = y		store	pts(y) <= pts(o) for o in pts(x)
+ *
+ * x -> f is handled as *x and x.f as x, ie the analysis is field insensitive.
+ * *x = *y and *x = &y go through a temporary node. Calls are not modelled.
+ *
+ * The solver propagates only the difference between the current and the
+ * already propagated points-to set of a node and collapses cycles of copy
+ * edges into one node, found lazily when an edge joins two equal sets.
+ */
+class AndersenPointsTo {
+	struct ConstraintNode {
+		SparseBitVector<> PointsTo;
+		// Part of PointsTo already propagated along the edges
+		SparseBitVector<> Propagated;
+		// Copy edges to the nodes including PointsTo
+		SparseBitVector<> Copy;
+		// Nodes x of x = *this and y of *this = y
+		SmallVector<unsigned, 2> Loads, Stores;
+	};
+	std::vector<ConstraintNode> Nodes;
+	// Representative of the nodes collapsed into a single node
+	std::vector<unsigned> Rep;
+	DenseMap<Value*, unsigned> NodeIds;
+	// Variable or heap object of every node, null for temporaries
+	std::vector<Value*> Values;
+	// Copy edges already checked for a cycle
+	DenseSet<std::pair<unsigned, unsigned>> CheckedEdges;
+	std::vector<unsigned> WorkList;
+	std::vector<bool> InWorkList;
+	unsigned NumCollapsed = 0;
+	unsigned getNode(Value*);
+	unsigned createNode(Value*);
+	unsigned find(unsigned);
+	void push(unsigned);
+	void addConstraints(UpdateInst*);
+	// Adds a copy edge and propagates the whole set, returns true if the
+	// edge is new
+	bool addCopyEdge(unsigned From, unsigned To);
+	void collapse(unsigned Into, unsigned N);
+	void collapseCycles(unsigned Root);
+	void solve();
+
+       public:
+	explicit AndersenPointsTo(const MetaDataStore&);
+	// Objects the value of V may point to, empty for unknown values
+	const SparseBitVector<>& getPointsTo(Value* V);
+	// Variable or heap object with the given id
+	Value* getObject(unsigned Id) const { return Values[Id]; }
+	bool mayPointTo(Value* P, Value* Obj);
+	bool mayAlias(Value*, Value*);
+	unsigned getNumNodes() const { return Nodes.size(); }
+	unsigned getNumCollapsed() const { return NumCollapsed; }
+};
+
+/* SteensgaardPointsTo
+ * Unification based points-to analysis, a coarse and fast alternative to
+ * AndersenPointsTo. Locations are kept in equivalence classes with union-find
+ * and every class points to at most one class. The table is consumed in one
+ * pass, every statement LHS = RHS unifies the class pointed to by the
+ * location of LHS with the value of RHS.
+ *
+ * The location of x is the node of the variable, x.f a field of it, *x the
+ * class pointed to by x and x -> f a field of that class. A field is keyed on
+ * the canonical GEP in optional. The value of &x is the location of x and the
+ * value of any other RHS is the class pointed to by its location.
+ */
+class SteensgaardPointsTo {
+	static const unsigned NoNode = ~0u;
+	std::vector<unsigned> Rep;
+	std::vector<uint8_t> Rank;
+	std::vector<unsigned> Pointee;
+	// Fields of the class, keyed on the canonical GEP
+	std::vector<SmallVector<std::pair<Value*, unsigned>, 0>> Fields;
+	DenseMap<Value*, unsigned> NodeIds;
+	// Pairs of classes left to unify
+	std::vector<std::pair<unsigned, unsigned>> Pending;
+	unsigned createNode();
+	unsigned getNode(Value*);
+	unsigned find(unsigned);
+	unsigned getPointee(unsigned);
+	unsigned getField(unsigned, Value*);
+	unsigned getLocation(Expression*);
+	unsigned getValue(UpdateInst*);
+	void join(unsigned, unsigned);
+	void unify(unsigned, unsigned);
+	// Class pointed to by the variable V without creating one
+	unsigned lookupPointee(Value* V);
+
+       public:
+	explicit SteensgaardPointsTo(const MetaDataStore&);
+	bool mayPointTo(Value* P, Value* Obj);
+	bool mayAlias(Value*, Value*);
+	unsigned getNumNodes() const { return Rep.size(); }
+};
+
+/* AndersenPrinterPass
+ * Prints the objects every variable of the module may point to,
+ * -passes='print<llvmir++-andersen>'. A heap object is printed as new and
+ * the value stored by its statement.
+ */
+class AndersenPrinterPass : public PassInfoMixin<AndersenPrinterPass> {
+	raw_ostream& OS;
+
+       public:
+	explicit AndersenPrinterPass(raw_ostream& OS) : OS(OS) {}
+	PreservedAnalyses run(Module&, ModuleAnalysisManager&);
+};
+
+/* SteensgaardPrinterPass
+ * Prints the objects every variable of the module may point to in the
+ * format of AndersenPrinterPass, -passes='print<llvmir++-steensgaard>'
+ */
+class SteensgaardPrinterPass : public PassInfoMixin<SteensgaardPrinterPass> {
+	raw_ostream& OS;
+
+       public:
+	explicit SteensgaardPrinterPass(raw_ostream& OS) : OS(OS) {}
+	PreservedAnalyses run(Module&, ModuleAnalysisManager&);
+};
+
+#endif
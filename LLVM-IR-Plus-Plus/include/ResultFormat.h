@@ -0,0 +1,439 @@
+#ifndef RESULTFORMAT_H
+#define RESULTFORMAT_H
+
+/* ResultFormat
+ * Binary format of the metadata and the abstracted cfgs of a module, written
+ * by writeResults (ResultWriter.h). This header does not depend on LLVM, a
+ * consumer maps the file and queries it in place through ResultReader.
+ *
+ * The file is little endian. It starts with a FileHeader followed by the
+ * sections listed in it, each one a packed array of records made of 32 bit
+ * words only:
+ *
+ * strings	NUL terminated strings, a string is named by its byte offset
+ * types	printed LLVM types
+ * values	values referred to by the other tables
+ * expressions	canonical LHS and RHS expressions
+ * statements	store assignments LHS = RHS, grouped by function
+ * functions	functions with a body in the order of the module
+ * nodes	abstracted cfg nodes, grouped by function in the order of their
+ *		Node::Id
+ * succ/pred	compressed sparse row edges, the successors of the global node
+ *		n are Succs[SuccOffsets[n] .. SuccOffsets[n + 1]), given by
+ *		their id within the function
+ *
+ * Every index is checked once when the reader is created, hence the queries
+ * of a valid reader never go out of bounds.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace irpp {
+
+static const char FileMagic[4] = {'I', 'R', 'P', 'B'};
+static const uint32_t FormatVersion = 2;
+// Missing value, expression, statement or type
+static const uint32_t NoIndex = ~0u;
+
+// Same values as SymbolType
+enum Symbol : uint32_t {
+	SimpleSymbol,
+	PointerSymbol,
+	ArrowSymbol,
+	DotSymbol,
+	ConstantSymbol,
+	AddressSymbol,
+	NewObjSymbol
+};
+
+// Same values as InstType and CallType
+enum NodeKind : uint32_t { IRNode, UpdateNode, CallNode };
+enum CallKind : uint32_t { DirectCall, IndirectCall, VirtualCall, IntrinsicCall };
+
+enum ValueKind : uint32_t {
+	InstructionValue,
+	ArgumentValue,
+	FunctionValue,
+	GlobalVariableValue,
+	ConstantValue,
+	OtherValue,
+	// Field of an Optional, named by its field path
+	FieldPathValue
+};
+
+enum SectionId : uint32_t {
+	StringSection,
+	TypeSection,
+	ValueSection,
+	ExpressionSection,
+	StatementSection,
+	FunctionSection,
+	NodeSection,
+	SuccOffsetSection,
+	SuccSection,
+	PredOffsetSection,
+	PredSection,
+	NumSections
+};
+
+// Byte offset in the file and number of records of a section
+struct Section {
+	uint64_t Offset;
+	uint64_t Count;
+};
+
+struct FileHeader {
+	char Magic[4];
+	uint32_t Version;
+	uint32_t NumSections;
+	uint32_t Reserved;
+	Section Sections[irpp::NumSections];
+};
+
+struct TypeRecord {
+	// Printed type
+	uint32_t Name;
+};
+
+struct ValueRecord {
+	// Name of the value, or the value printed as an operand if it has none
+	// and the opcode if it is a void instruction. A field path is the
+	// source element type and the indices of the field access, eg
+	// "%struct.Point, i32 0, i32 1"
+	uint32_t Name;
+	uint32_t Kind;
+	// Function of an instruction or an argument, NoIndex otherwise or if
+	// that function is not part of the file
+	uint32_t Function;
+	// Source line of an instruction, 0 if unknown
+	uint32_t Line;
+};
+
+struct ExpressionRecord {
+	// Values, see Expression
+	uint32_t Base;
+	uint32_t Optional;
+	uint32_t Type;
+	uint32_t Symbol;
+	uint32_t FunctionArg;
+	uint32_t RHSisAddress;
+};
+
+struct StatementRecord {
+	uint32_t Function;
+	// The store instruction
+	uint32_t Inst;
+	uint32_t LHS;
+	uint32_t RHS;
+	// Id of the update node in the cfg of the function
+	uint32_t Node;
+};
+
+struct FunctionRecord {
+	uint32_t Name;
+	uint32_t Value;
+	uint32_t FirstStatement;
+	uint32_t NumStatements;
+	// Global index of the entry node, the exit node is the last one
+	uint32_t FirstNode;
+	uint32_t NumNodes;
+};
+
+struct NodeRecord {
+	// The instruction, NoIndex for the pseudo exit node
+	uint32_t Inst;
+	uint32_t Kind;
+	// Statement of an update node
+	uint32_t Statement;
+	// Call nodes only: kind of the call, value of the called function of a
+	// direct call, expression of the called value and receiver expression
+	// of a virtual call
+	uint32_t Call;
+	uint32_t Callee;
+	uint32_t CalleeExpression;
+	uint32_t Receiver;
+};
+
+/* ArrayView
+ * Read only view of records inside the mapped file
+ */
+template <typename T>
+class ArrayView {
+	const T* Data = nullptr;
+	size_t Size = 0;
+
+       public:
+	ArrayView() = default;
+	ArrayView(const T* Data, size_t Size) : Data(Data), Size(Size) {}
+	const T* begin() const { return Data; }
+	const T* end() const { return Data + Size; }
+	size_t size() const { return Size; }
+	bool empty() const { return Size == 0; }
+	const T& operator[](size_t I) const { return Data[I]; }
+};
+
+/* ResultReader
+ * Zero copy view of a result file held in memory, eg mapped by
+ * MappedResultFile. The buffer must stay alive and 8 byte aligned while the
+ * reader is used. isValid() is false for a truncated, corrupted or foreign
+ * file, nothing else may be queried then.
+ */
+class ResultReader {
+	const char* Data = nullptr;
+	uint64_t Size = 0;
+	const FileHeader* Header = nullptr;
+	bool Valid = false;
+
+	template <typename T>
+	ArrayView<T> getSection(SectionId Id) const {
+		const Section& S = Header->Sections[Id];
+		return ArrayView<T>(reinterpret_cast<const T*>(Data + S.Offset),
+				    S.Count);
+	}
+	bool checkSection(SectionId Id, uint64_t RecordSize) const {
+		const Section& S = Header->Sections[Id];
+		return S.Offset % 4 == 0 && S.Offset <= Size &&
+		       S.Count <= (Size - S.Offset) / RecordSize;
+	}
+	static bool isLittleEndian() {
+		uint16_t Probe = 1;
+		char First;
+		std::memcpy(&First, &Probe, 1);
+		return First == 1;
+	}
+	bool checkValue(uint32_t V) const {
+		return V == NoIndex || V < getValues().size();
+	}
+	bool checkExpression(uint32_t E) const {
+		return E == NoIndex || E < getExpressions().size();
+	}
+	bool checkString(uint32_t S) const {
+		return S < getSection<char>(StringSection).size();
+	}
+	bool checkTables() const;
+	bool checkEdges(SectionId Offsets, SectionId Edges) const;
+
+       public:
+	ResultReader() = default;
+	ResultReader(const void* Buffer, uint64_t BufferSize)
+	    : Data(static_cast<const char*>(Buffer)), Size(BufferSize) {
+		Header = reinterpret_cast<const FileHeader*>(Data);
+		Valid = isLittleEndian() && Data &&
+			reinterpret_cast<uintptr_t>(Data) % 8 == 0 &&
+			Size >= sizeof(FileHeader) &&
+			!std::memcmp(Header->Magic, FileMagic, 4) &&
+			Header->Version == FormatVersion &&
+			Header->NumSections == NumSections && checkTables();
+	}
+	bool isValid() const { return Valid; }
+
+	ArrayView<TypeRecord> getTypes() const {
+		return getSection<TypeRecord>(TypeSection);
+	}
+	ArrayView<ValueRecord> getValues() const {
+		return getSection<ValueRecord>(ValueSection);
+	}
+	ArrayView<ExpressionRecord> getExpressions() const {
+		return getSection<ExpressionRecord>(ExpressionSection);
+	}
+	ArrayView<StatementRecord> getStatements() const {
+		return getSection<StatementRecord>(StatementSection);
+	}
+	ArrayView<FunctionRecord> getFunctions() const {
+		return getSection<FunctionRecord>(FunctionSection);
+	}
+	ArrayView<NodeRecord> getNodes() const {
+		return getSection<NodeRecord>(NodeSection);
+	}
+	const char* getString(uint32_t S) const {
+		return Data + Header->Sections[StringSection].Offset + S;
+	}
+
+	// Statements and cfg nodes of a function
+	ArrayView<StatementRecord> getStatements(const FunctionRecord& F) const {
+		return ArrayView<StatementRecord>(
+		    getStatements().begin() + F.FirstStatement,
+		    F.NumStatements);
+	}
+	ArrayView<NodeRecord> getNodes(const FunctionRecord& F) const {
+		return ArrayView<NodeRecord>(getNodes().begin() + F.FirstNode,
+					     F.NumNodes);
+	}
+	// Successors and predecessors of node N of the function, by id
+	ArrayView<uint32_t> getSucc(const FunctionRecord& F, uint32_t N) const {
+		return getEdges(SuccOffsetSection, SuccSection, F.FirstNode + N);
+	}
+	ArrayView<uint32_t> getPred(const FunctionRecord& F, uint32_t N) const {
+		return getEdges(PredOffsetSection, PredSection, F.FirstNode + N);
+	}
+
+       private:
+	ArrayView<uint32_t> getEdges(SectionId Offsets, SectionId Edges,
+				     uint32_t N) const {
+		ArrayView<uint32_t> Offset = getSection<uint32_t>(Offsets);
+		return ArrayView<uint32_t>(
+		    getSection<uint32_t>(Edges).begin() + Offset[N],
+		    Offset[N + 1] - Offset[N]);
+	}
+};
+
+/* checkTables
+ * Checks the bounds of every section and every index stored in the records
+ */
+inline bool ResultReader::checkTables() const {
+	static const uint64_t RecordSizes[NumSections] = {
+	    1,
+	    sizeof(TypeRecord),
+	    sizeof(ValueRecord),
+	    sizeof(ExpressionRecord),
+	    sizeof(StatementRecord),
+	    sizeof(FunctionRecord),
+	    sizeof(NodeRecord),
+	    4,
+	    4,
+	    4,
+	    4};
+	for (uint32_t Id = 0; Id < NumSections; Id++) {
+		if (!checkSection(SectionId(Id), RecordSizes[Id])) {
+			return false;
+		}
+	}
+	// Strings can not run past the end of the table
+	ArrayView<char> Strings = getSection<char>(StringSection);
+	if (!Strings.empty() && Strings[Strings.size() - 1] != '\0') {
+		return false;
+	}
+	for (const TypeRecord& T : getTypes()) {
+		if (!checkString(T.Name)) {
+			return false;
+		}
+	}
+	for (const ValueRecord& V : getValues()) {
+		if (!checkString(V.Name) || V.Kind > FieldPathValue ||
+		    (V.Function != NoIndex && V.Function >= getFunctions().size())) {
+			return false;
+		}
+	}
+	for (const ExpressionRecord& E : getExpressions()) {
+		if (!checkValue(E.Base) || !checkValue(E.Optional) ||
+		    !checkValue(E.FunctionArg) || E.Symbol > NewObjSymbol ||
+		    (E.Type != NoIndex && E.Type >= getTypes().size())) {
+			return false;
+		}
+	}
+	uint64_t NextStatement = 0, NextNode = 0;
+	for (const FunctionRecord& F : getFunctions()) {
+		if (!checkString(F.Name) || !checkValue(F.Value) ||
+		    F.FirstStatement != NextStatement || F.FirstNode != NextNode) {
+			return false;
+		}
+		NextStatement += F.NumStatements;
+		NextNode += F.NumNodes;
+	}
+	if (NextStatement != getStatements().size() ||
+	    NextNode != getNodes().size()) {
+		return false;
+	}
+	for (const StatementRecord& S : getStatements()) {
+		if (S.Function >= getFunctions().size() || !checkValue(S.Inst) ||
+		    !checkExpression(S.LHS) || !checkExpression(S.RHS) ||
+		    (S.Node != NoIndex &&
+		     S.Node >= getFunctions()[S.Function].NumNodes)) {
+			return false;
+		}
+	}
+	for (const NodeRecord& N : getNodes()) {
+		if (!checkValue(N.Inst) || N.Kind > CallNode ||
+		    N.Call > IntrinsicCall || !checkValue(N.Callee) ||
+		    !checkExpression(N.CalleeExpression) ||
+		    !checkExpression(N.Receiver) ||
+		    (N.Statement != NoIndex &&
+		     N.Statement >= getStatements().size())) {
+			return false;
+		}
+	}
+	return checkEdges(SuccOffsetSection, SuccSection) &&
+	       checkEdges(PredOffsetSection, PredSection);
+}
+
+/* checkEdges
+ * Offsets are monotonic and every edge stays within the cfg of its function
+ */
+inline bool ResultReader::checkEdges(SectionId Offsets, SectionId Edges) const {
+	ArrayView<uint32_t> Offset = getSection<uint32_t>(Offsets);
+	ArrayView<uint32_t> Edge = getSection<uint32_t>(Edges);
+	if (Offset.size() != getNodes().size() + 1 || Offset[0] != 0 ||
+	    Offset[Offset.size() - 1] != Edge.size()) {
+		return false;
+	}
+	for (const FunctionRecord& F : getFunctions()) {
+		for (uint32_t N = F.FirstNode; N < F.FirstNode + F.NumNodes; N++) {
+			if (Offset[N] > Offset[N + 1] || Offset[N + 1] > Edge.size()) {
+				return false;
+			}
+			for (uint32_t E = Offset[N]; E < Offset[N + 1]; E++) {
+				if (Edge[E] >= F.NumNodes) {
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+/* MappedResultFile
+ * Maps a result file read only, the reader is valid as long as the object
+ * lives
+ */
+class MappedResultFile {
+	void* Address = nullptr;
+	size_t Size = 0;
+	ResultReader Reader;
+
+       public:
+	MappedResultFile() = default;
+	MappedResultFile(const MappedResultFile&) = delete;
+	MappedResultFile& operator=(const MappedResultFile&) = delete;
+	~MappedResultFile() { close(); }
+	// Returns false if the file can not be mapped or is not valid
+	bool open(const char* Path) {
+		close();
+		int FD = ::open(Path, O_RDONLY);
+		if (FD < 0) {
+			return false;
+		}
+		struct stat Stat;
+		if (fstat(FD, &Stat) == 0 && Stat.st_size > 0) {
+			Size = Stat.st_size;
+			Address = mmap(nullptr, Size, PROT_READ, MAP_PRIVATE, FD, 0);
+			if (Address == MAP_FAILED) {
+				Address = nullptr;
+			}
+		}
+		::close(FD);
+		if (!Address) {
+			return false;
+		}
+		Reader = ResultReader(Address, Size);
+		return Reader.isValid();
+	}
+	void close() {
+		if (Address) {
+			munmap(Address, Size);
+		}
+		Address = nullptr;
+		Size = 0;
+		Reader = ResultReader();
+	}
+	const ResultReader& getReader() const { return Reader; }
+};
+
+}  // namespace irpp
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef RESULTWRITER_H
+#define RESULTWRITER_H
+
+#include <string>
+#include <vector>
+#include "LLVMIR++.h"
+#include "ResultFormat.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/ModuleSlotTracker.h"
+#include "llvm/Support/JSON.h"
+
+/* BinaryResultWriter
+ * Builds a result file in the binary format of ResultFormat.h function by
+ * function and writes it at once. Values, types, strings and expressions are
+ * added on first use. Nothing local to a function is kept once it is added,
+ * its metadata, its cfg and its body can be dropped.
+ */
+class BinaryResultWriter {
+	ModuleSlotTracker Slots;
+	std::string Strings;
+	StringMap<uint32_t> StringIds;
+	std::vector<irpp::TypeRecord> Types;
+	DenseMap<Type*, uint32_t> TypeIds;
+	std::vector<irpp::ValueRecord> Values;
+	DenseMap<const Value*, uint32_t> ValueIds;
+	// Field path values by the id of their name
+	DenseMap<uint32_t, uint32_t> FieldPathIds;
+	std::vector<irpp::ExpressionRecord> Expressions;
+	DenseMap<const Expression*, uint32_t> ExpressionIds;
+	std::vector<irpp::StatementRecord> Statements;
+	std::vector<irpp::FunctionRecord> Functions;
+	DenseMap<const Function*, uint32_t> FunctionIds;
+	std::vector<irpp::NodeRecord> Nodes;
+	std::vector<uint32_t> SuccOffsets{0}, Succs, PredOffsets{0}, Preds;
+
+	uint32_t addString(StringRef);
+	uint32_t addType(Type*);
+	uint32_t addValue(const Value*);
+	uint32_t addOptional(const Value*);
+	uint32_t addExpression(const Expression*);
+	// Drops the ids of the values and expressions local to the function
+	void forgetLocals(Function&);
+
+       public:
+	explicit BinaryResultWriter(Module& M) : Slots(&M) {}
+	// Adds the statements and the abstracted cfg of the function, it is
+	// analyzed if it is not yet
+	void addFunction(Function&, IRPlusPlusInfo&);
+	void write(raw_ostream&);
+};
+
+/* JSONLinesWriter
+ * Writes one JSON object per line, function by function: a function record,
+ * then its statements, then the edges of its abstracted cfg. Nothing but the
+ * record being written is buffered.
+ */
+class JSONLinesWriter {
+	raw_ostream& OS;
+	ModuleSlotTracker Slots;
+	std::string ModuleName;
+	void writeHeader(json::OStream&, StringRef, Function&);
+	void attribute(json::OStream&, StringRef, const Value*);
+	void attribute(json::OStream&, StringRef, const Expression*);
+	void optional(json::OStream&, const Value*);
+
+       public:
+	JSONLinesWriter(Module& M, raw_ostream& OS) : OS(OS), Slots(&M) {}
+	// Tags every record with the module, for streams merged from several
+	// modules
+	void setModuleName(StringRef Name) { ModuleName = Name.str(); }
+	// Writes the records of the function, it is analyzed if it is not yet
+	void addFunction(Function&, IRPlusPlusInfo&);
+};
+
+/* writeResults
+ * Writes the metadata and the abstracted cfg of every function with a body
+ * in M in the binary format of ResultFormat.h. Functions that are not
+ * analyzed yet are analyzed on the way.
+ */
+void writeResults(Module& M, IRPlusPlusInfo& Info, raw_ostream& OS);
+
+// Writes the results to the file, returns false and reports the error if it
+// can not be written
+bool writeResults(Module& M, IRPlusPlusInfo& Info, StringRef Path);
+
+/* writeJSONLines
+ * Streams the statements and the abstracted cfg edges of every function with
+ * a body in M as JSON Lines, one object per function, statement or edge.
+ * Functions that are not analyzed yet are analyzed and released again one at
+ * a time.
+ */
+void writeJSONLines(Module& M, IRPlusPlusInfo& Info, raw_ostream& OS);
+
+// Writes the JSON Lines to the file, "-" is stdout, returns false and reports
+// the error if it can not be written
+bool writeJSONLines(Module& M, IRPlusPlusInfo& Info, StringRef Path);
+
+// Opens the file, "-" is stdout, and writes it through a buffer of Size
+// bytes. Returns false and reports the error if it can not be written
+bool writeFile(StringRef Path, size_t Size,
+	       function_ref<void(raw_ostream&)> Write);
+
+#endif
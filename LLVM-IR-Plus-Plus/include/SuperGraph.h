@@ -0,0 +1,102 @@
+#ifndef SUPERGRAPH_H
+#define SUPERGRAPH_H
+
+#include <deque>
+#include <vector>
+#include "LLVMIR++.h"
+#include "VFCR.h"
+#include "llvm/ADT/GraphTraits.h"
+
+/* CallGraphVertex
+ * A function of the module and the functions its call nodes may call
+ */
+class CallGraphVertex {
+       public:
+	// null for the root of the call graph
+	Function* F;
+	std::vector<CallGraphVertex*> Callees;
+	// Call nodes of the abstracted cfg of F
+	NodeList CallNodes;
+	explicit CallGraphVertex(Function* F) : F(F) {}
+};
+
+/* ModuleCallGraph
+ * Call graph of a module built from the call nodes of the abstracted cfgs.
+ * A direct call calls Func, a virtual call the targets of the
+ * VirtualCallResolver (none without a resolver) and an indirect call every
+ * function of the same type whose address is taken. Intrinsics are ignored.
+ * The root vertex calls every function of the module so that every function
+ * is reached from it.
+ */
+class ModuleCallGraph {
+	std::deque<CallGraphVertex> Vertices;
+	CallGraphVertex* Root;
+	DenseMap<Function*, CallGraphVertex*> FunctionVertices;
+	DenseMap<const Node*, ArrayRef<Function*>> CallTargets;
+	// Address taken functions by type, the targets of indirect calls
+	DenseMap<FunctionType*, std::vector<Function*>> AddressTaken;
+
+       public:
+	ModuleCallGraph(Module&, IRPlusPlusInfo&,
+			VirtualCallResolver* = nullptr);
+	CallGraphVertex* getRoot() { return Root; }
+	CallGraphVertex* getVertex(Function* F) const {
+		return FunctionVertices.lookup(F);
+	}
+	// Functions a call node may call. The array is owned by the call graph
+	// or by its resolver and is valid as long as both are alive.
+	ArrayRef<Function*> getCallees(const Node* N) const {
+		return CallTargets.lookup(N);
+	}
+	// Strongly connected components of functions, callees before their
+	// callers
+	std::vector<std::vector<Function*>> getBottomUpSCCs();
+};
+
+namespace llvm {
+template <>
+struct GraphTraits<CallGraphVertex*> {
+	using NodeRef = CallGraphVertex*;
+	using ChildIteratorType = std::vector<CallGraphVertex*>::iterator;
+	static NodeRef getEntryNode(CallGraphVertex* V) { return V; }
+	static ChildIteratorType child_begin(NodeRef N) {
+		return N->Callees.begin();
+	}
+	static ChildIteratorType child_end(NodeRef N) {
+		return N->Callees.end();
+	}
+};
+
+template <>
+struct GraphTraits<ModuleCallGraph*> : GraphTraits<CallGraphVertex*> {
+	static NodeRef getEntryNode(ModuleCallGraph* CG) {
+		return CG->getRoot();
+	}
+};
+}  // namespace llvm
+
+/* SuperGraph
+ * Links the abstracted cfgs of a module, every call node to the entry and
+ * exit nodes of its callees and the exit node of every function back to the
+ * call nodes calling it. Calls return to the successors of the call node.
+ */
+class SuperGraph {
+	ModuleCallGraph& CallGraph;
+	struct CallEdges {
+		NodeList Entries, Exits;
+	};
+	DenseMap<const Node*, CallEdges> Calls;
+	DenseMap<Function*, NodeList> CallSites;
+
+       public:
+	SuperGraph(ModuleCallGraph&, IRPlusPlusInfo&);
+	ModuleCallGraph& getCallGraph() { return CallGraph; }
+	// Entry nodes of the callees of a call node with a body
+	ArrayRef<Node*> getCalleeEntries(const Node* Call) const;
+	// Exit nodes of the callees of a call node with a body
+	ArrayRef<Node*> getCalleeExits(const Node* Call) const;
+	// Call nodes that may call F, ie the return edges of its exit node
+	ArrayRef<Node*> getCallSites(Function* F) const;
+};
+
+#endif
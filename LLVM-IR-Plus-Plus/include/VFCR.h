@@ -0,0 +1,73 @@
+#ifndef VFCR_H
+#define VFCR_H
+
+#include <map>
+#include <tuple>
+#include <vector>
+#include "LLVMIR++.h"
+#include "llvm/ADT/StringMap.h"
+
+/* VirtualCallResolver
+ * Virtual function call resolution. The class hierarchy and the slots of
+ * every vtable are read once per module from the _ZTI typeinfo and _ZTV
+ * vtable globals of the Itanium C++ ABI. A virtual call through slot k of a
+ * receiver of static class C may call slot k of the vtable of C or of any
+ * class derived from C.
+ *
+ * The targets of a (class, slot) pair are computed on the first call site
+ * using them and the targets of a call site are memoized, so every later
+ * lookup is a single hash lookup. When the class of the receiver is unknown
+ * the targets are the functions of type matching the call in slot k of all
+ * vtables. Only the primary vtable of a class is read, calls through a
+ * secondary base of a class with multiple inheritance resolve to the
+ * classes whose primary vtable has the slot.
+ */
+class VirtualCallResolver {
+	static const unsigned NoClass = ~0u;
+	struct ClassInfo {
+		// Entries of the primary vtable from its address point, null
+		// for pure virtual functions
+		std::vector<Function*> Slots;
+		SmallVector<unsigned, 1> Bases;
+		SmallVector<unsigned, 2> Derived;
+	};
+	std::vector<ClassInfo> Classes;
+	// Mangled class names eg 1A for _ZTV1A and _ZTI1A
+	StringMap<unsigned> ClassIds;
+	DenseMap<StructType*, unsigned> TypeClasses;
+	// Targets of (class, slot, function type), the function type is only
+	// part of the key of unknown classes
+	std::map<std::tuple<unsigned, unsigned, FunctionType*>,
+		 std::vector<Function*>>
+	    SlotTargets;
+	DenseMap<const CallInst*, ArrayRef<Function*>> CallTargets;
+	unsigned getClass(StringRef MangledName);
+	unsigned getClass(Type* ReceiverTy);
+	void readVTable(GlobalVariable*);
+	void readTypeInfo(GlobalVariable*);
+	ArrayRef<Function*> resolve(unsigned Class, unsigned Slot,
+				    FunctionType*);
+
+       public:
+	explicit VirtualCallResolver(Module&);
+	// Slot of the vtable a virtual call loads its callee from
+	static bool getSlot(const CallInst*, unsigned& Slot);
+	// Possible targets of a virtual call, empty for other calls
+	ArrayRef<Function*> getTargets(const CallInst*);
+	ArrayRef<Function*> getTargets(const Node*);
+	unsigned getNumClasses() const { return Classes.size(); }
+};
+
+/* VFCRPrinterPass
+ * Prints the slot and the possible targets of every virtual call,
+ * -passes='print<llvmir++-vfcr>'
+ */
+class VFCRPrinterPass : public PassInfoMixin<VFCRPrinterPass> {
+	raw_ostream& OS;
+
+       public:
+	explicit VFCRPrinterPass(raw_ostream& OS) : OS(OS) {}
+	PreservedAnalyses run(Module&, ModuleAnalysisManager&);
+};
+
+#endif
@@ -0,0 +1,47 @@
+; The results do not depend on how many functions are analyzed together, the
+; tool writes the same records one function at a time, all at once and as the
+; pass does
+; RUN: rm -rf %t && mkdir -p %t
+; RUN: %tool %s -batch-size=1 -o %t/one.jsonl
+; RUN: %tool %s -batch-size=1000 -o %t/all.jsonl
+; RUN: %opt -enable-new-pm=0 -load %plugin -llvmir++ -llvmir++-emit-json=%t/pass.jsonl -disable-output %s
+; RUN: diff %t/one.jsonl %t/all.jsonl
+; RUN: diff %t/one.jsonl %t/pass.jsonl
+; RUN: FileCheck %s < %t/one.jsonl
+; RUN: %tool %s -batch-size=1 -format=binary -o %t/one.irpb
+; RUN: %tool %s -batch-size=1000 -format=binary -o %t/all.irpb
+; RUN: cmp %t/one.irpb %t/all.irpb
+
+%struct.Pair = type { i32, [4 x i32] }
+
+; Both functions store through the same field paths
+; CHECK: "function":"first",{{.*}}"optional":"%struct.Pair, i32 0, i32 0"
+; CHECK: "function":"first",{{.*}}"optional":"%struct.Pair, i32 0, i32 1, i32 2"
+; CHECK: "function":"second",{{.*}}"optional":"%struct.Pair, i32 0, i32 0"
+; CHECK: "function":"second",{{.*}}"optional":"%struct.Pair, i32 0, i32 1, i32 2"
+define void @first(%struct.Pair* %p) {
+entry:
+  %p.addr = alloca %struct.Pair*
+  store %struct.Pair* %p, %struct.Pair** %p.addr
+  %0 = load %struct.Pair*, %struct.Pair** %p.addr
+  %a = getelementptr inbounds %struct.Pair, %struct.Pair* %0, i32 0, i32 0
+  store i32 1, i32* %a
+  %1 = load %struct.Pair*, %struct.Pair** %p.addr
+  %b = getelementptr inbounds %struct.Pair, %struct.Pair* %1, i32 0, i32 1, i32 2
+  store i32 2, i32* %b
+  ret void
+}
+
+define void @second(%struct.Pair* %q) {
+entry:
+  %q.addr = alloca %struct.Pair*
+  store %struct.Pair* %q, %struct.Pair** %q.addr
+  %0 = load %struct.Pair*, %struct.Pair** %q.addr
+  %a2 = getelementptr inbounds %struct.Pair, %struct.Pair* %0, i32 0, i32 0
+  store i32 3, i32* %a2
+  %1 = load %struct.Pair*, %struct.Pair** %q.addr
+  %b2 = getelementptr inbounds %struct.Pair, %struct.Pair* %1, i32 0, i32 1, i32 2
+  store i32 4, i32* %b2
+  call void @first(%struct.Pair* %q)
+  ret void
+}
@@ -0,0 +1,76 @@
+; Results restored from the summary cache match the analysis, a damaged
+; cache file is a miss
+; RUN: rm -rf %t && mkdir -p %t
+; RUN: %tool %s -o %t/uncached.jsonl
+; RUN: %tool %s -llvmir++-cache-dir=%t/cache -o %t/cold.jsonl -stats 2>&1 | FileCheck %s --check-prefixes=MISS,COUNT
+; RUN: %tool %s -llvmir++-cache-dir=%t/cache -o %t/warm.jsonl -stats 2>&1 | FileCheck %s --check-prefixes=HIT,COUNT
+; RUN: diff %t/uncached.jsonl %t/cold.jsonl
+; RUN: diff %t/uncached.jsonl %t/warm.jsonl
+
+; Truncated files
+; RUN: for F in %t/cache/*.irpp; do head -c $(( $(wc -c < $F) / 2 )) $F > $F.cut && mv $F.cut $F; done
+; RUN: %tool %s -llvmir++-cache-dir=%t/cache -o %t/truncated.jsonl -stats 2>&1 | FileCheck %s --check-prefixes=MISS,COUNT
+; RUN: diff %t/uncached.jsonl %t/truncated.jsonl
+
+; Files of the current version with garbage counts
+; RUN: for F in %t/cache/*.irpp; do printf 'IRPC\2\0\0\0\377\377\377\377' > $F; done
+; RUN: %tool %s -llvmir++-cache-dir=%t/cache -o %t/garbage.jsonl -stats 2>&1 | FileCheck %s --check-prefixes=MISS,COUNT
+; RUN: diff %t/uncached.jsonl %t/garbage.jsonl
+
+; MISS:     Statistics Collected
+; MISS-NOT: restored from the summary cache
+; HIT: 3 llvmir++ - Number of functions restored from the summary cache
+; Restored functions are counted like analyzed ones, once
+; COUNT: 2 llvmir++ - Number of direct calls
+; COUNT: 7 llvmir++ - Number of stores abstracted
+
+%struct.Point = type { i32, double }
+
+@origin = global %struct.Point zeroinitializer
+
+define void @init(%struct.Point* %p) {
+entry:
+  %p.addr = alloca %struct.Point*
+  store %struct.Point* %p, %struct.Point** %p.addr
+  %0 = load %struct.Point*, %struct.Point** %p.addr
+  %x = getelementptr inbounds %struct.Point, %struct.Point* %0, i32 0, i32 0
+  store i32 123456789, i32* %x
+  %1 = load %struct.Point*, %struct.Point** %p.addr
+  %y = getelementptr inbounds %struct.Point, %struct.Point* %1, i32 0, i32 1
+  store double 2.500000e+00, double* %y
+  ret void
+}
+
+define i32 @sum(i32 %n) {
+entry:
+  %i = alloca i32
+  %s = alloca i64
+  store i32 0, i32* %i
+  store i64 -81985529216486896, i64* %s
+  br label %cond
+
+cond:
+  %iv = load i32, i32* %i
+  %c = icmp slt i32 %iv, %n
+  br i1 %c, label %body, label %exit
+
+body:
+  %t = load i32, i32* %i
+  %u = add i32 %t, 1
+  store i32 %u, i32* %i
+  br label %cond
+
+exit:
+  %r = load i32, i32* %i
+  ret i32 %r
+}
+
+define void @main() {
+entry:
+  %q = alloca %struct.Point*
+  store %struct.Point* @origin, %struct.Point** %q
+  %0 = load %struct.Point*, %struct.Point** %q
+  call void @init(%struct.Point* %0)
+  %1 = call i32 @sum(i32 10)
+  ret void
+}
@@ -0,0 +1,108 @@
+; Liveness and reaching definitions over the statements of a branch and of a
+; loop
+; RUN: %opt -load-pass-plugin %plugin -passes='print<llvmir++-dataflow>' -disable-output %s 2>&1 | FileCheck %s
+
+; x is defined on both paths, both definitions reach y = x
+; CHECK-LABEL: Dataflow of branch:
+; CHECK:       node 1: store i32 1, i32* %x
+; CHECK-NEXT:    live-in:{{$}}
+; CHECK-NEXT:    live-out: %x
+; CHECK-NEXT:    reaching-in:{{$}}
+; CHECK-NEXT:    reaching-out: 1
+; CHECK-NEXT:  node 2: store i32 2, i32* %x
+; CHECK-NEXT:    live-in:{{$}}
+; CHECK-NEXT:    live-out: %x
+; CHECK-NEXT:    reaching-in: 1
+; CHECK-NEXT:    reaching-out: 2
+; CHECK-NEXT:  node 3: store i32 %v, i32* %y
+; CHECK-NEXT:    live-in: %x
+; CHECK-NEXT:    live-out:{{$}}
+; CHECK-NEXT:    reaching-in: 1 2
+; CHECK-NEXT:    reaching-out: 1 2 3
+define i32 @branch(i1 %c) {
+entry:
+  %x = alloca i32
+  %y = alloca i32
+  store i32 1, i32* %x
+  br i1 %c, label %then, label %join
+
+then:
+  store i32 2, i32* %x
+  br label %join
+
+join:
+  %v = load i32, i32* %x
+  store i32 %v, i32* %y
+  %r = load i32, i32* %y
+  ret i32 %r
+}
+
+; i is live around the back edge, the definition in the body kills the one
+; before the loop
+; CHECK-LABEL: Dataflow of loop:
+; CHECK:       node 1: store i32 0, i32* %i
+; CHECK-NEXT:    live-in:{{$}}
+; CHECK-NEXT:    live-out: %i
+; CHECK:       node 2: store i32 %t, i32* %s
+; CHECK-NEXT:    live-in: %i
+; CHECK-NEXT:    live-out:{{$}}
+; CHECK-NEXT:    reaching-in: 1 2 3
+; CHECK-NEXT:    reaching-out: 1 2 3
+; CHECK-NEXT:  node 3: store i32 %u, i32* %i
+; CHECK-NEXT:    live-in:{{$}}
+; CHECK-NEXT:    live-out: %i
+; CHECK-NEXT:    reaching-in: 1 2 3
+; CHECK-NEXT:    reaching-out: 2 3
+; CHECK-NEXT:  node 4: exit
+; CHECK-NEXT:    live-in:{{$}}
+define void @loop(i32 %n) {
+entry:
+  %i = alloca i32
+  %s = alloca i32
+  store i32 0, i32* %i
+  br label %cond
+
+cond:
+  %iv = load i32, i32* %i
+  %c = icmp slt i32 %iv, %n
+  br i1 %c, label %body, label %exit
+
+body:
+  %t = load i32, i32* %i
+  store i32 %t, i32* %s
+  %u = add i32 %t, 1
+  store i32 %u, i32* %i
+  br label %cond
+
+exit:
+  ret void
+}
+
+; q = p reads p although the right hand side is a pointer, only p = &x takes
+; an address without reading
+; CHECK-LABEL: Dataflow of copy:
+; CHECK:       node 1: store i32* %x, i32** %p
+; CHECK-NEXT:    live-in:{{$}}
+; CHECK-NEXT:    live-out: %p
+; CHECK-NEXT:    reaching-in:{{$}}
+; CHECK-NEXT:    reaching-out: 1
+; CHECK-NEXT:  node 2: store i32* %a, i32** %q
+; CHECK-NEXT:    live-in: %p
+; CHECK-NEXT:    live-out: %q
+; CHECK-NEXT:    reaching-in: 1
+; CHECK-NEXT:    reaching-out: 1 2
+; CHECK-NEXT:  node 3: store i32 1, i32* %b
+; CHECK-NEXT:    live-in: %q
+; CHECK-NEXT:    live-out:{{$}}
+define void @copy() {
+entry:
+  %x = alloca i32
+  %p = alloca i32*
+  %q = alloca i32*
+  store i32* %x, i32** %p
+  %a = load i32*, i32** %p
+  store i32* %a, i32** %q
+  %b = load i32*, i32** %q
+  store i32 1, i32* %b
+  ret void
+}
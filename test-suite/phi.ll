@@ -0,0 +1,23 @@
+; The operands of a phi in a loop lead back to the phi, the RHS of the store
+; is found without walking the cycle forever
+; RUN: %tool %s -o - | FileCheck %s
+
+; CHECK: "function":"count","node":2,"lhs":{"symbol":"simple","base":"i.addr",{{.*}}"rhs":{{{.*}}"base":"n.addr"
+define void @count(i32 %n) {
+entry:
+  %n.addr = alloca i32
+  %i.addr = alloca i32
+  store i32 %n, i32* %n.addr
+  %v = load i32, i32* %n.addr
+  br label %loop
+
+loop:
+  %i = phi i32 [ %v, %entry ], [ %inc, %loop ]
+  %inc = add i32 %i, 1
+  store i32 %inc, i32* %i.addr
+  %c = icmp slt i32 %inc, 10
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
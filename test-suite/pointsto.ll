@@ -0,0 +1,57 @@
+; Points-to sets of address, copy, store through and heap statements, and a
+; global stored directly
+; RUN: %opt -load-pass-plugin %plugin -passes='print<llvmir++-andersen>' -disable-output %s 2>&1 | FileCheck %s --check-prefix=ANDERSEN
+; RUN: %opt -load-pass-plugin %plugin -passes='print<llvmir++-steensgaard>' -disable-output %s 2>&1 | FileCheck %s --check-prefix=STEENS
+
+; Inclusion keeps the targets of every pointer apart
+; ANDERSEN:      Andersen points-to of
+; ANDERSEN-NEXT:   %p -> %x{{$}}
+; ANDERSEN-NEXT:   %q -> %y{{$}}
+; ANDERSEN-NEXT:   %r -> %x @g{{$}}
+; ANDERSEN-NEXT:   %pp -> %s{{$}}
+; ANDERSEN-NEXT:   %s -> %y{{$}}
+; ANDERSEN-NEXT:   %h -> new %obj{{$}}
+; ANDERSEN-NOT:  ->
+
+; Unification merges the targets of r = p and r = &g, p may point to g too
+; STEENS:      Steensgaard points-to of
+; STEENS-NEXT:   %p -> %x @g{{$}}
+; STEENS-NEXT:   %q -> %y{{$}}
+; STEENS-NEXT:   %r -> %x @g{{$}}
+; STEENS-NEXT:   %pp -> %s{{$}}
+; STEENS-NEXT:   %s -> %y{{$}}
+; STEENS-NEXT:   %h -> new %obj{{$}}
+; STEENS-NOT:  ->
+
+@g = global i32 0
+
+define void @pts() {
+entry:
+  %x = alloca i32
+  %y = alloca i32
+  %p = alloca i32*
+  %q = alloca i32*
+  %r = alloca i32*
+  %s = alloca i32*
+  %h = alloca i32*
+  %pp = alloca i32**
+  ; p = &x, q = &y, r = p
+  store i32* %x, i32** %p
+  store i32* %y, i32** %q
+  %a = load i32*, i32** %p
+  store i32* %a, i32** %r
+  ; pp = &s, *pp = q
+  store i32** %s, i32*** %pp
+  %b = load i32**, i32*** %pp
+  %c = load i32*, i32** %q
+  store i32* %c, i32** %b
+  ; h = new
+  %call = call noalias i8* @_Znwm(i64 4)
+  %obj = bitcast i8* %call to i32*
+  store i32* %obj, i32** %h
+  ; r = &g
+  store i32* @g, i32** %r
+  ret void
+}
+
+declare i8* @_Znwm(i64)
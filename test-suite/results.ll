@@ -0,0 +1,68 @@
+; Binary results read back through the LLVM free reader, and files the
+; reader must reject
+; RUN: rm -rf %t && mkdir -p %t
+; RUN: %tool %s -format=binary -o %t/r.irpb
+; RUN: %dump %t/r.irpb | FileCheck %s
+; Lazy mode releases every function once written and must write the same
+; JSON Lines as eager mode
+; RUN: %opt -enable-new-pm=0 -load %plugin -llvmir++ -llvmir++-emit-json=%t/eager.jsonl -disable-output %s
+; RUN: %opt -enable-new-pm=0 -load %plugin -llvmir++ -llvmir++-lazy -llvmir++-emit-json=%t/lazy.jsonl -disable-output %s
+; RUN: cmp %t/eager.jsonl %t/lazy.jsonl
+
+; Truncated file
+; RUN: head -c 200 %t/r.irpb > %t/cut.irpb
+; RUN: not %dump %t/cut.irpb 2>&1 | FileCheck %s --check-prefix=INVALID
+; Foreign magic
+; RUN: cp %t/r.irpb %t/magic.irpb && printf 'XXXX' | dd of=%t/magic.irpb conv=notrunc 2>/dev/null
+; RUN: not %dump %t/magic.irpb 2>&1 | FileCheck %s --check-prefix=INVALID
+; Other version
+; RUN: cp %t/r.irpb %t/version.irpb && printf '\377' | dd of=%t/version.irpb bs=1 seek=4 conv=notrunc 2>/dev/null
+; RUN: not %dump %t/version.irpb 2>&1 | FileCheck %s --check-prefix=INVALID
+; Value section running past the end of the file, its count is at byte 56
+; RUN: cp %t/r.irpb %t/count.irpb && printf '\377\377\377\377' | dd of=%t/count.irpb bs=1 seek=56 conv=notrunc 2>/dev/null
+; RUN: not %dump %t/count.irpb 2>&1 | FileCheck %s --check-prefix=INVALID
+; Function index of the first value out of range, the value section starts
+; at the offset stored at byte 48
+; RUN: cp %t/r.irpb %t/index.irpb && Off=$(od -An -tu8 -j48 -N8 %t/r.irpb) && printf '\376\377\377\377' | dd of=%t/index.irpb bs=1 seek=$((Off + 8)) conv=notrunc 2>/dev/null
+; RUN: not %dump %t/index.irpb 2>&1 | FileCheck %s --check-prefix=INVALID
+
+; INVALID: not a valid result file
+
+%struct.Point = type { i32, i32 }
+
+; CHECK:      function setx
+; CHECK-NEXT:   statement store node 1: simple p.addr = address p
+; CHECK-NEXT:   statement store node 2: arrow p.addr %struct.Point, i32 0, i32 0 = constant -
+; CHECK-NEXT:   node 0 ir p.addr: succ 1 pred{{$}}
+; CHECK-NEXT:   node 1 update store: succ 2 pred 0
+; CHECK-NEXT:   node 2 update store: succ 3 pred 1
+; CHECK-NEXT:   node 3 ir -: succ pred 2
+define void @setx(%struct.Point* %p) {
+entry:
+  %p.addr = alloca %struct.Point*
+  store %struct.Point* %p, %struct.Point** %p.addr
+  %0 = load %struct.Point*, %struct.Point** %p.addr
+  %x = getelementptr inbounds %struct.Point, %struct.Point* %0, i32 0, i32 0
+  store i32 1, i32* %x
+  ret void
+}
+
+; %x2 has the field path of %x in setx
+; CHECK:      function resetx
+; CHECK-NEXT:   statement store node 1: simple q.addr = address q
+; CHECK-NEXT:   statement store node 2: arrow q.addr %struct.Point, i32 0, i32 0 = constant -
+; CHECK-NEXT:   node 0 ir q.addr: succ 1 pred{{$}}
+; CHECK-NEXT:   node 1 update store: succ 2 pred 0
+; CHECK-NEXT:   node 2 update store: succ 3 pred 1
+; CHECK-NEXT:   node 3 call call direct setx: succ 4 pred 2
+; CHECK-NEXT:   node 4 ir -: succ pred 3
+define void @resetx(%struct.Point* %q) {
+entry:
+  %q.addr = alloca %struct.Point*
+  store %struct.Point* %q, %struct.Point** %q.addr
+  %0 = load %struct.Point*, %struct.Point** %q.addr
+  %x2 = getelementptr inbounds %struct.Point, %struct.Point* %0, i32 0, i32 0
+  store i32 0, i32* %x2
+  call void @setx(%struct.Point* %q)
+  ret void
+}
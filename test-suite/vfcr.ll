@@ -0,0 +1,75 @@
+; Targets of virtual calls from the vtables and the typeinfos of a small
+; hierarchy, B derives from A and C is unrelated
+; RUN: %opt -load-pass-plugin %plugin -passes='print<llvmir++-vfcr>' -disable-output %s 2>&1 | FileCheck %s
+
+; CHECK-LABEL: Virtual calls of callA:
+; CHECK-NEXT:    %g = call i32 %1(%class.A* %a)
+; CHECK-NEXT:      slot: 1
+; CHECK-NEXT:      targets: @_ZN1A1gEv @_ZN1B1gEv{{$}}
+; CHECK-NEXT:    %f = call i32 %2(%class.A* %a)
+; CHECK-NEXT:      slot: 0
+; CHECK-NEXT:      targets: @_ZN1A1fEv{{$}}
+; CHECK-LABEL: Virtual calls of callB:
+; CHECK-NEXT:    %g = call i32 %1(%class.B* %b)
+; CHECK-NEXT:      slot: 1
+; CHECK-NEXT:      targets: @_ZN1B1gEv{{$}}
+; CHECK-NOT:   call
+
+%class.A = type { i32 (...)** }
+%class.B = type { %class.A }
+%class.C = type { i32 (...)** }
+
+@_ZTV1A = constant { [4 x i8*] } { [4 x i8*] [i8* null, i8* bitcast ({ i8*, i8* }* @_ZTI1A to i8*), i8* bitcast (i32 (%class.A*)* @_ZN1A1fEv to i8*), i8* bitcast (i32 (%class.A*)* @_ZN1A1gEv to i8*)] }
+@_ZTV1B = constant { [4 x i8*] } { [4 x i8*] [i8* null, i8* bitcast ({ i8*, i8*, i8* }* @_ZTI1B to i8*), i8* bitcast (i32 (%class.A*)* @_ZN1A1fEv to i8*), i8* bitcast (i32 (%class.B*)* @_ZN1B1gEv to i8*)] }
+@_ZTV1C = constant { [3 x i8*] } { [3 x i8*] [i8* null, i8* bitcast ({ i8*, i8* }* @_ZTI1C to i8*), i8* bitcast (i32 (%class.C*)* @_ZN1C1fEv to i8*)] }
+@_ZTVN10__cxxabiv117__class_type_infoE = external global i8*
+@_ZTVN10__cxxabiv120__si_class_type_infoE = external global i8*
+@_ZTS1A = constant [3 x i8] c"1A\00"
+@_ZTS1B = constant [3 x i8] c"1B\00"
+@_ZTS1C = constant [3 x i8] c"1C\00"
+@_ZTI1A = constant { i8*, i8* } { i8* bitcast (i8** getelementptr inbounds (i8*, i8** @_ZTVN10__cxxabiv117__class_type_infoE, i64 2) to i8*), i8* getelementptr inbounds ([3 x i8], [3 x i8]* @_ZTS1A, i32 0, i32 0) }
+@_ZTI1B = constant { i8*, i8*, i8* } { i8* bitcast (i8** getelementptr inbounds (i8*, i8** @_ZTVN10__cxxabiv120__si_class_type_infoE, i64 2) to i8*), i8* getelementptr inbounds ([3 x i8], [3 x i8]* @_ZTS1B, i32 0, i32 0), i8* bitcast ({ i8*, i8* }* @_ZTI1A to i8*) }
+@_ZTI1C = constant { i8*, i8* } { i8* bitcast (i8** getelementptr inbounds (i8*, i8** @_ZTVN10__cxxabiv117__class_type_infoE, i64 2) to i8*), i8* getelementptr inbounds ([3 x i8], [3 x i8]* @_ZTS1C, i32 0, i32 0) }
+
+define i32 @_ZN1A1fEv(%class.A* %this) {
+  ret i32 1
+}
+
+define i32 @_ZN1A1gEv(%class.A* %this) {
+  ret i32 2
+}
+
+define i32 @_ZN1B1gEv(%class.B* %this) {
+  ret i32 3
+}
+
+define i32 @_ZN1C1fEv(%class.C* %this) {
+  ret i32 4
+}
+
+; a -> g() may call A::g and B::g, a -> f() through slot 0 only A::f
+define i32 @callA(%class.A* %a) {
+entry:
+  %0 = bitcast %class.A* %a to i32 (%class.A*)***
+  %vtable = load i32 (%class.A*)**, i32 (%class.A*)*** %0
+  %vfn = getelementptr inbounds i32 (%class.A*)*, i32 (%class.A*)** %vtable, i64 1
+  %1 = load i32 (%class.A*)*, i32 (%class.A*)** %vfn
+  %g = call i32 %1(%class.A* %a)
+  %vfn1 = getelementptr inbounds i32 (%class.A*)*, i32 (%class.A*)** %vtable, i64 0
+  %2 = load i32 (%class.A*)*, i32 (%class.A*)** %vfn1
+  %f = call i32 %2(%class.A* %a)
+  %r = add i32 %g, %f
+  ret i32 %r
+}
+
+; b -> g() only calls B::g, the direct call is not virtual
+define i32 @callB(%class.B* %b) {
+entry:
+  %0 = bitcast %class.B* %b to i32 (%class.B*)***
+  %vtable = load i32 (%class.B*)**, i32 (%class.B*)*** %0
+  %vfn = getelementptr inbounds i32 (%class.B*)*, i32 (%class.B*)** %vtable, i64 1
+  %1 = load i32 (%class.B*)*, i32 (%class.B*)** %vfn
+  %g = call i32 %1(%class.B* %b)
+  %d = call i32 @_ZN1C1fEv(%class.C* null)
+  ret i32 %g
+}